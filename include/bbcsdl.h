@@ -25,6 +25,7 @@
 #define	SOUNDQE         4       // Number of bytes per sound entry
 #define SOUNDQL         5*SOUNDQE // Number of bytes per channel
 #define MAX_EVENTS	512	// Maximum SDL events to queue
+#define VDURING		4096	// VDU ring size in records (power of 2)
 #define MAX_TEMPO	10	// Maximum (slowest) *TEMPO setting
 
 // User-defined message IDs:
@@ -56,6 +57,7 @@
 #define EVT_TIMER	0x2010	// Set new timer period
 #define EVT_FSSYNC	0x2011  // Sync filesystem (Emscripten)
 #define EVT_RUNJS	0x2012  // Run Javascript (Emscripten)
+#define EVT_VDURUN	0x2013	// Run of VDU commands waiting in ring
 
 // Bit names:
 
@@ -149,6 +151,13 @@ typedef struct tagRND
 	unsigned char h ;
 } RND, *LPRND ;
 
+typedef struct tagVDUREC
+{
+	int code ;  // EVT_VDU or packed VDU command
+	int data1 ;
+	int data2 ;
+} VDUREC, *LPVDUREC ;
+
 // Variables declared in bbcsdl.c:
 extern SDL_Renderer *memhdc ;
 extern SDL_Window *hwndProg ;
@@ -272,6 +281,10 @@ extern unsigned int vcount ;    // Character count since newline
 // Declared in bbcsdl.c:
 extern size_t iResult ;		// Result from user event
 extern int nUserEv ;		// Number of pending user events
+extern VDUREC vduring[] ;	// VDU ring (interpreter -> GUI thread)
+extern int vduwi ;		// VDU ring write index (interpreter)
+extern int vduri ;		// VDU ring read index (GUI)
+extern int vdubell ;		// EVT_VDURUN event outstanding
 extern int OSKtime ;		// On-screen keyboard timeout
 extern SDL_sem *Sema4 ;		// Semaphore for user event wait
 extern SDL_mutex *Mutex ;	// Mutex to protect event queue
@@ -20,6 +20,7 @@
 #define ESCTIME 200  // Milliseconds to wait for escape sequence
 #define QRYTIME 1000 // Milliseconds to wait for cursor query response
 #define QSIZE 32     // Twice longest expected escape sequence
+#define OUTBUFLEN 65536 // Size of stdout buffer when output is buffered
 
 #ifdef _WIN32
 #include <windows.h>
@@ -87,6 +88,7 @@ char *szCmdLine ;
 intptr_t MaximumRAM = MAXIMUM_RAM ;
 timer_t UserTimerID ;
 unsigned int palette[256] ;
+unsigned char outbuf = 0 ;	// Buffer output until a flush point (*FLUSH ON)
 void *TTFcache[1] ;
 
 // Array of VDU command lengths:
@@ -585,6 +587,15 @@ size_t guicall (void *func, PARM *parm)
 	return apicall_ (func, parm) ;
 }
 
+// Flush buffered output to stdout and ports:
+void osflush (void)
+{
+	if (outbuf)
+		fflush (NULL) ;
+	else
+		fflush (stdout) ;
+}
+
 // Check for Escape (if enabled) and kill:
 void trap (void)
 {
@@ -609,6 +620,8 @@ void trap (void)
 // Test for escape, kill, pause, single-step, flash and alert:
 heapptr xtrap (void)
 {
+	if (outbuf)
+		osflush () ; // Periodic flush, ALERT is set by the timer
 	trap () ;
 	if (flags & ALERT)
 		return getevt () ;
@@ -666,6 +679,7 @@ int oskey (int wait)
 	if (wait >= 0)
 	    {
 		unsigned int start = GetTicks () ;
+		osflush () ;
 		while (1)
 		    {
 			unsigned char key ;
@@ -699,6 +713,7 @@ unsigned char osrdch (void)
 	if (optval >> 4)
 		return osbget ((void *)(size_t)(optval >> 4), NULL) ;
 
+	osflush () ;
 	while (!rdkey (&key))
 	{
 		usleep (5000) ;
@@ -742,7 +757,8 @@ void oswrch (unsigned char vdu)
 			pqueue -= ecx - 9 ;
 				for ( ; ecx > 0 ; ecx--)
 					xeqvdu (*pqueue++ << 8, 0, 0) ;
-			fflush (stdout) ;
+			if (!outbuf)
+				fflush (stdout) ;
 			return ;
 		    }
 	    }
@@ -757,7 +773,8 @@ void oswrch (unsigned char vdu)
 			return ;
 		    }
 		xeqvdu (vdu << 8, 0, 0) ;
-		fflush (stdout) ;
+		if (!outbuf)
+			fflush (stdout) ;
 		return ;
 	    }
 	else
@@ -1320,6 +1337,8 @@ unsigned char osbget (void *chan, int *peof)
 		*peof = 0 ;
 	if (chan <= (void *)MAX_PORTS)
 	    {
+		if (outbuf)
+			fflush (lookup (chan)) ;
 #ifdef _WIN32
 		intptr_t file = _get_osfhandle (fileno (lookup (chan))) ;
 		ReadFile ((HANDLE) file, &byte, 1, NULL, NULL) ;
@@ -1358,6 +1377,11 @@ void osbput (void *chan, unsigned char byte)
 {
 	if (chan <= (void *) MAX_PORTS)
 	    {
+		if (outbuf)
+		    {
+			fwrite (&byte, 1, 1, lookup (chan)) ;
+			return ;
+		    }
 #ifdef _WIN32
 		intptr_t file = _get_osfhandle (fileno (lookup (chan))) ;
 		WriteFile ((HANDLE) file, &byte, 1, NULL, NULL) ;
@@ -1909,6 +1933,15 @@ pthread_t hThread = NULL ;
 	else if (TestFile == NULL)
 		chdir (szLoadDir) ;
 
+	// Buffer output when it is redirected to a file or pipe:
+#ifdef _WIN32
+	outbuf = !_isatty (_fileno (stdout)) ;
+#else
+	outbuf = !isatty (STDOUT_FILENO) ;
+#endif
+	if (outbuf)
+		setvbuf (stdout, NULL, _IOFBF, OUTBUFLEN) ;
+
 	// Set console for raw input and ANSI output:
 #ifdef _WIN32
 	// n.b.  Description of DISABLE_NEWLINE_AUTO_RETURN at MSDN is completely wrong!
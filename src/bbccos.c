@@ -38,7 +38,7 @@ typedef dispatch_source_t timer_t ;
 #endif
 
 #undef MAX_PATH
-#define NCMDS 42	// number of OSCLI commands
+#define NCMDS 43	// number of OSCLI commands
 #define POWR2 32	// largest power-of-2 less than NCMDS
 #ifdef PICO
 #define COPYBUFLEN 512	// length of buffer used for *COPY command
@@ -90,9 +90,15 @@ void StopTimer (timer_t) ;
 void SystemIO (int) ;
 int stdin_handler (int*, int*) ;
 int getkey (unsigned char *) ;
+#ifndef PICO
+void osflush (void) ;
+#endif
 
 // Global variables:
 extern timer_t UserTimerID ;
+#ifndef PICO
+extern unsigned char outbuf ;
+#endif
 
 static short modetab[NUMMODES][5] =
 {
@@ -111,7 +117,7 @@ static short modetab[NUMMODES][5] =
 
 static char *cmds[NCMDS] = {
 		"bye", "cd", "chdir", "copy", "del", "delete", "dir",
-		"dump", "era", "erase", "esc", "exec", "float", "fx",
+		"dump", "era", "erase", "esc", "exec", "float", "flush", "fx",
 		"help", "hex", "input", "key", "list", "load", "lock", "lowercase",
 		"md", "mkdir", "output", "quit", "rd", "refresh",
 		"ren", "rename", "rmdir", "run", "save", "spool", "spoolon",
@@ -119,7 +125,7 @@ static char *cmds[NCMDS] = {
 
 enum {
 		BYE, CD, CHDIR, COPY, DEL, DELETE, DIRCMD,
-		DUMP, ERA, ERASE, ESC, EXEC, FLOAT, FX,
+		DUMP, ERA, ERASE, ESC, EXEC, FLOAT, FLUSH, FX,
 		HELP, HEX, INPUT, KEY, LIST, LOAD, LOCK, LOWERCASE,
 		MD, MKDIR, OUTPUT, QUIT, RD, REFRESH,
 		REN, RENAME, RMDIR, RUN, SAVE, SPOOL, SPOOLON,
@@ -443,6 +449,10 @@ void xeqvdu (int code, int data1, int data2)
 					col++ ;
 			    }
 	    }
+#ifndef PICO
+	if (outbuf)
+		return ;
+#endif
 	fflush (stdout) ;
 }
 
@@ -618,6 +628,9 @@ void oscli (char *cmd)
 	if ((*cmd == 0x0D) || (*cmd == '|'))
 		return ;
 
+#ifndef PICO
+	osflush () ; // Star commands are a flush point
+#endif
 	q = memchr (cmd, 0x0D, sizeof(cpy)) ;
 	if (q == NULL)
 		error (19, NULL) ; // 'String too long'
@@ -841,6 +854,13 @@ void oscli (char *cmd)
 			    }
 			return ;
 
+		case FLUSH:			// *FLUSH [ON|OFF]
+#ifndef PICO
+			if (*p != 0x0D)
+				outbuf = onoff (p) ;
+#endif
+			return ;
+
 		case FX:
 			n = 0 ; b = 0 ;
 			sscanf (p, "%i,%i", &n, &b) ;
@@ -1249,21 +1269,11 @@ static int compare (void *src, void *dst, unsigned char type)
 
 		case 136:
 		    {
-			unsigned int len ;
 			STR s = *(STR*)src ;
 			STR d = *(STR*)dst ;
-			len = s.l ;
-			if (len > d.l)
-				len = d.l ;
-			while (len--)
-			    {
-				int result = ((*(d.p + zero) > *(s.p + zero)) -
-					      (*(d.p + zero) < *(s.p + zero))) ;
-				if (result)
-					return result ;
-				d.p++ ;
-				s.p++ ;
-			    }
+			int result = memcmp (d.p + zero, s.p + zero, s.l < d.l ? s.l : d.l) ;
+			if (result)
+				return (result > 0) - (result < 0) ;
 			return (d.l > s.l) - (d.l < s.l) ;
 		    }
 	    }
@@ -1344,8 +1354,435 @@ static void shellsort (int dir, int ecx, void* ebp)
 	return ;
 }
 
+#ifndef PICO
+#define SORTTHR 64	// Maximum number of sort threads (as MAXTHR in bbeval)
+#define SORTPAR 100000	// Minimum number of elements for a parallel sort
+
+extern int sortthreads ;
+
+void parallel (void (*) (void *), void *, int, int) ; // Run jobs concurrently
+int threads (int) ;		// Number of threads to use
+
+// Sort engine: sort an index of the elements, by LSD radix sort if every
+// array is of a numeric type with a fixed-width binary key, otherwise by
+// introsort, then permute all the arrays into that order.  Every array is
+// a key, in order of significance, but elements which compare equal may
+// still differ (-0 and +0, or the integer and float forms of a variant) so
+// the sort is stable, making the result independent of the number of
+// threads.  Returns 0 if there isn't memory for the index.
+
+typedef struct tagSORTKEY
+{
+	unsigned char type ;	// Array type
+	char *base ;		// Address of first element
+} SORTKEY ;
+
+// Compare elements i and j of all the arrays, returning -1, 0 or +1:
+static int keycmp (SORTKEY *keys, int num, unsigned int i, unsigned int j)
+{
+	while (num--)
+	    {
+		unsigned char type = keys->type ;
+		int size = type & 15 ;
+		char *a = keys->base + i * size ;
+		char *b = keys->base + j * size ;
+		int result = compare (b, a, type) ;
+		if (result)
+			return result ;
+		keys++ ;
+	    }
+	return 0 ;
+}
+
+// Compare elements i and j in the direction of the sort, the one first in
+// the original order being the lesser if their keys are equal (this makes
+// the introsort stable, since the index holds every element exactly once):
+static int runcmp (SORTKEY *keys, int num, int dir, unsigned int i, unsigned int j)
+{
+	int result = dir * keycmp (keys, num, i, j) ;
+	if (result)
+		return result ;
+	return (i > j) - (i < j) ;
+}
+
+// Sift an element down a heap of n elements:
+static void siftdown (unsigned int *h, int root, int n, SORTKEY *keys, int num, int dir)
+{
+	int child ;
+	while ((child = 2 * root + 1) < n)
+	    {
+		unsigned int tmp ;
+		if ((child + 1 < n) && (runcmp (keys, num, dir, h[child], h[child + 1]) < 0))
+			child++ ;
+		if (runcmp (keys, num, dir, h[root], h[child]) >= 0)
+			break ;
+		tmp = h[root] ; h[root] = h[child] ; h[child] = tmp ;
+		root = child ;
+	    }
+}
+
+// Introsort of index[lo..hi) (median-of-three quicksort, switching
+// to heapsort if the recursion gets too deep, insertion sort when small):
+static void introsort (unsigned int *index, int lo, int hi, int depth,
+			SORTKEY *keys, int num, int dir)
+{
+	while (hi - lo > 16)
+	    {
+		unsigned int pivot, tmp ;
+		int i, j, mid ;
+
+		if (depth-- == 0)
+		    {
+			// Heapsort:
+			int n = hi - lo, k ;
+			unsigned int *h = index + lo ;
+			for (k = n / 2 - 1; k >= 0; k--)
+				siftdown (h, k, n, keys, num, dir) ;
+			for (k = n - 1; k > 0; k--)
+			    {
+				tmp = h[0] ; h[0] = h[k] ; h[k] = tmp ;
+				siftdown (h, 0, k, keys, num, dir) ;
+			    }
+			return ;
+		    }
+
+		// Median of three to index[lo]:
+		mid = lo + (hi - lo) / 2 ;
+		if (runcmp (keys, num, dir, index[mid], index[lo]) < 0)
+			{ tmp = index[mid] ; index[mid] = index[lo] ; index[lo] = tmp ; }
+		if (runcmp (keys, num, dir, index[hi - 1], index[mid]) < 0)
+		    {
+			tmp = index[hi - 1] ; index[hi - 1] = index[mid] ; index[mid] = tmp ;
+			if (runcmp (keys, num, dir, index[mid], index[lo]) < 0)
+				{ tmp = index[mid] ; index[mid] = index[lo] ; index[lo] = tmp ; }
+		    }
+		tmp = index[mid] ; index[mid] = index[lo] ; index[lo] = tmp ;
+		pivot = index[lo] ;
+
+		// Hoare partition:
+		i = lo ;
+		j = hi ;
+		while (1)
+		    {
+			while ((++i < hi) && (runcmp (keys, num, dir, index[i], pivot) < 0)) ;
+			while (runcmp (keys, num, dir, index[--j], pivot) > 0) ;
+			if (i >= j)
+				break ;
+			tmp = index[i] ; index[i] = index[j] ; index[j] = tmp ;
+		    }
+		index[lo] = index[j] ;
+		index[j] = pivot ;
+
+		// Recurse into the smaller part, loop on the larger:
+		if (j - lo < hi - j)
+		    {
+			introsort (index, lo, j, depth, keys, num, dir) ;
+			lo = j + 1 ;
+		    }
+		else
+		    {
+			introsort (index, j + 1, hi, depth, keys, num, dir) ;
+			hi = j ;
+		    }
+	    }
+
+	// Insertion sort:
+	for (int i = lo + 1; i < hi; i++)
+	    {
+		unsigned int x = index[i] ;
+		int j = i ;
+		while ((j > lo) && (runcmp (keys, num, dir, x, index[j - 1]) < 0))
+		    {
+			index[j] = index[j - 1] ;
+			j-- ;
+		    }
+		index[j] = x ;
+	    }
+}
+
+// Get a key which sorts as an unsigned integer, or return 0 if the type
+// has none:
+static int radixkey (unsigned char type, char *p, unsigned long long *pkey)
+{
+	switch (type)
+	    {
+		case 1:
+			*pkey = *(unsigned char *)p ;
+			return 1 ;
+
+		case 4:
+			*pkey = (unsigned int)*(unaligned_int *)p ^ 0x80000000 ;
+			return 4 ;
+
+		case 40:
+			*pkey = (unsigned long long)*(unaligned_longlong *)p ^ 0x8000000000000000ULL ;
+			return 8 ;
+
+		case 8:
+		    {
+			double d = *(unaligned_double *)p ;
+			unsigned long long n ;
+			memcpy (&n, &d, 8) ;
+			if (d == 0)
+				n = 0 ; // -0 == +0
+			*pkey = (n >> 63) ? ~n : n ^ 0x8000000000000000ULL ;
+			return 8 ;
+		    }
+	    }
+	return 0 ;
+}
+
+// Stable LSD radix sort of index[] by each key array, least significant
+// first.  Returns 0 if there isn't enough memory:
+static int radixsort (unsigned int *index, int n, SORTKEY *keys, int num, int dir)
+{
+	unsigned long long *kv = malloc (2 * n * sizeof(unsigned long long)) ;
+	unsigned int *tmp = malloc (n * sizeof(unsigned int)) ;
+	int k, b, i ;
+
+	if ((kv == NULL) || (tmp == NULL))
+	    {
+		free (kv) ;
+		free (tmp) ;
+		return 0 ;
+	    }
+
+	for (k = num - 1; k >= 0; k--)
+	    {
+		unsigned char type = keys[k].type ;
+		int size = type & 15, width = 0 ;
+		unsigned long long *kw = kv + n ;
+		unsigned int count[8][256] = {{0}} ;
+
+		for (i = 0; i < n; i++)
+		    {
+			unsigned long long key ;
+			width = radixkey (type, keys[k].base + index[i] * size, &key) ;
+			if (dir)
+				key = ~key ;
+			kv[i] = key ;
+			for (b = 0; b < width; b++)
+				count[b][(key >> (b * 8)) & 0xFF]++ ;
+		    }
+
+		for (b = 0; b < width; b++)
+		    {
+			unsigned int sum = 0, *c = count[b] ;
+			int shift = b * 8 ;
+			if (c[kv[0] >> shift & 0xFF] == n)
+				continue ; // all elements have the same digit
+			for (i = 0; i < 256; i++)
+			    {
+				unsigned int t = c[i] ;
+				c[i] = sum ;
+				sum += t ;
+			    }
+			for (i = 0; i < n; i++)
+			    {
+				unsigned int d = c[kv[i] >> shift & 0xFF]++ ;
+				kw[d] = kv[i] ;
+				tmp[d] = index[i] ;
+			    }
+			memcpy (kv, kw, n * sizeof(unsigned long long)) ;
+			memcpy (index, tmp, n * sizeof(unsigned int)) ;
+		    }
+	    }
+
+	free (kv) ;
+	free (tmp) ;
+	return 1 ;
+}
+
+// Parallel sort: above SORTPAR elements the index is split into one run
+// per thread, the runs are sorted concurrently and then merged pairwise,
+// the merges at each level also running concurrently.  The merge takes
+// the left element when keys are equal so the sort is stable.
+
+typedef struct tagSORTJOB
+{
+	unsigned int *src ;	// Index to sort or merge from
+	unsigned int *dst ;	// Index to merge into (NULL = sort src)
+	int lo, mid, hi ;	// Run(s) src[lo..mid) and src[mid..hi)
+	SORTKEY *keys ;
+	int num, dir, radix ;
+} SORTJOB ;
+
+static void sortjob (void *param)
+{
+	SORTJOB *job = param ;
+	unsigned int *src = job->src ;
+	int lo = job->lo, mid = job->mid, hi = job->hi ;
+	int i = lo, j = mid, k = lo ;
+
+	if (job->dst == NULL)
+	    {
+		if (!job->radix || !radixsort (src + lo, hi - lo, job->keys, job->num, job->dir))
+		    {
+			int depth = 0 ;
+			for (i = hi - lo; i; i >>= 1)
+				depth += 2 ;
+			introsort (src, lo, hi, depth, job->keys, job->num, job->dir ? -1 : 1) ;
+		    }
+		return ;
+	    }
+
+	while ((i < mid) && (j < hi))
+	    {
+		int result = keycmp (job->keys, job->num, src[j], src[i]) ;
+		if (job->dir ? result > 0 : result < 0)
+			job->dst[k++] = src[j++] ;
+		else
+			job->dst[k++] = src[i++] ;
+	    }
+	while (i < mid)
+		job->dst[k++] = src[i++] ;
+	while (j < hi)
+		job->dst[k++] = src[j++] ;
+}
+
+// Number of threads to use for sorting n elements:
+static int sortnthr (int n)
+{
+	int nthr ;
+	if (n < SORTPAR)
+		return 1 ;
+	nthr = threads (sortthreads) ;
+	if (nthr > n / (SORTPAR / 2))
+		nthr = n / (SORTPAR / 2) ;
+	return nthr > 1 ? nthr : 1 ;
+}
+
+// Sort index[0..n) using nthr threads.  Returns 0 if there isn't enough
+// memory for the merge buffer:
+static int parsort (unsigned int *index, int n, int nthr, SORTKEY *keys, int num, int dir, int radix)
+{
+	SORTJOB jobs[SORTTHR] ;
+	int bound[SORTTHR + 1] ;
+	unsigned int *src = index, *dst ;
+	int i, runs = nthr ;
+
+	dst = malloc (n * sizeof(unsigned int)) ;
+	if (dst == NULL)
+		return 0 ;
+
+	for (i = 0; i <= nthr; i++)
+		bound[i] = (long long) n * i / nthr ;
+	for (i = 0; i < nthr; i++)
+	    {
+		jobs[i].src = src ;
+		jobs[i].dst = NULL ;
+		jobs[i].lo = bound[i] ;
+		jobs[i].mid = bound[i + 1] ;
+		jobs[i].hi = bound[i + 1] ;
+		jobs[i].keys = keys ;
+		jobs[i].num = num ;
+		jobs[i].dir = dir ;
+		jobs[i].radix = radix ;
+	    }
+	parallel (sortjob, jobs, sizeof(SORTJOB), nthr) ;
+
+	while (runs > 1)
+	    {
+		unsigned int *tmp ;
+		int merges = 0 ;
+		for (i = 0; i < runs; i += 2)
+		    {
+			jobs[merges].src = src ;
+			jobs[merges].dst = dst ;
+			jobs[merges].lo = bound[i] ;
+			jobs[merges].mid = bound[i + 1] ;
+			jobs[merges].hi = bound[i + 1 < runs ? i + 2 : i + 1] ;
+			bound[merges++] = bound[i] ;
+		    }
+		bound[merges] = n ;
+		parallel (sortjob, jobs, sizeof(SORTJOB), merges) ;
+		runs = merges ;
+		tmp = src ; src = dst ; dst = tmp ;
+	    }
+
+	if (src != index)
+	    {
+		memcpy (index, src, n * sizeof(unsigned int)) ;
+		free (src) ;
+	    }
+	else
+		free (dst) ;
+	return 1 ;
+}
+
+static int sortarr (int dir, int ecx, void *ebp)
+{
+	SORTKEY keys[255] ;
+	unsigned int *index ;
+	int num, i, k, nthr, radix = 1, maxsize = 1 ;
+	char *buf ;
+
+	if (ecx <= 1)
+		return 1 ;
+
+	num = *(unsigned char *)ebp++ ; // number of arrays
+	for (k = 0; k < num; k++)
+	    {
+		unsigned long long key ;
+		keys[k].type = *(unsigned char *)ebp++ ;
+		keys[k].base = *(unaligned_charptr *)ebp ;
+		ebp += sizeof(void *) ;
+		if (radixkey (keys[k].type, keys[k].base, &key) == 0)
+			radix = 0 ;
+		if ((keys[k].type & 15) > maxsize)
+			maxsize = keys[k].type & 15 ;
+	    }
+
+	index = malloc (ecx * sizeof(unsigned int)) ;
+	buf = malloc (ecx * maxsize) ;
+	if ((index == NULL) || (buf == NULL))
+	    {
+		free (index) ;
+		free (buf) ;
+		return 0 ;
+	    }
+
+	for (i = 0; i < ecx; i++)
+		index[i] = i ;
+
+	nthr = sortnthr (ecx) ;
+	if ((nthr == 1) || !parsort (index, ecx, nthr, keys, num, dir, radix))
+	    {
+		SORTJOB job = {index, NULL, 0, ecx, ecx, keys, num, dir, radix} ;
+		sortjob (&job) ;
+	    }
+
+	// Permute the arrays:
+	for (k = 0; k < num; k++)
+	    {
+		int size = keys[k].type & 15 ;
+		char *base = keys[k].base ;
+		for (i = 0; i < ecx; i++)
+			memcpy (buf + i * size, base + index[i] * size, size) ;
+		memcpy (base, buf, ecx * size) ;
+	    }
+
+	free (index) ;
+	free (buf) ;
+	return 1 ;
+}
+#endif
+
 void sortup (int eax, int ebx, int ecx, unsigned int edx, unsigned int esi, unsigned int edi, void *ebp)
-{ shellsort (0, ecx, ebp) ; }
+{
+#ifndef PICO
+	if (sortarr (0, ecx, ebp))
+		return ;
+#endif
+	shellsort (0, ecx, ebp) ;
+}
+
 void sortdn (int eax, int ebx, int ecx, unsigned int edx, unsigned int esi, unsigned int edi, void *ebp)
-{ shellsort (1, ecx, ebp) ; }
+{
+#ifndef PICO
+	if (sortarr (1, ecx, ebp))
+		return ;
+#endif
+	shellsort (1, ecx, ebp) ;
+}
 void hook(void){} ;
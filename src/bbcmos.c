@@ -918,11 +918,54 @@ static int BBC_PushEvent(SDL_Event* event)
 	return ret ;
 }
 
+// Put VDU command into ring, ring the bell if GUI thread not already draining it:
+static void vduput (int code, void *data1, void *data2)
+{
+	int wi = vduwi ;
+	LPVDUREC rec ;
+
+	while ((wi - SDL_AtomicGet ((SDL_atomic_t*) &vduri)) >= VDURING)
+	    {
+		if (flags & KILL)
+			return ;
+		SDL_Delay (1) ;
+	    }
+
+	rec = vduring + (wi & (VDURING - 1)) ;
+	rec->code = code ;
+	rec->data1 = (intptr_t) data1 ;
+	rec->data2 = (intptr_t) data2 ;
+	SDL_AtomicSet ((SDL_atomic_t*) &vduwi, wi + 1) ; // Publish record
+
+	if (SDL_AtomicCAS ((SDL_atomic_t*) &vdubell, 0, 1))
+	    {
+		SDL_Event event ;
+		event.type = SDL_USEREVENT ;
+		event.user.code = EVT_VDURUN ;
+		event.user.data1 = NULL ;
+		event.user.data2 = NULL ;
+		SDL_AtomicIncRef ((SDL_atomic_t*) &nUserEv) ;
+		while (BBC_PushEvent (&event) <= 0)
+			SDL_Delay (1) ;
+	    }
+}
+
 // Push event onto queue:
 void pushev (int code, void *data1, void *data2)
 {
 	SDL_Event event ;
 
+	// VDU output is batched through the ring rather than sent as individual events:
+	if ((code == EVT_VDU) || ((code >= 0x0100) && (code <= 0x1FFF)))
+	    {
+		vduput (code, data1, data2) ;
+		return ;
+	    }
+
+	// Other events must not overtake VDU commands still in the ring:
+	while ((SDL_AtomicGet ((SDL_atomic_t*) &vduri) != vduwi) && ((flags & KILL) == 0))
+		SDL_Delay (1) ;
+
 	event.type = SDL_USEREVENT ;
 	event.user.code = code ;
 	event.user.data1 = data1 ;
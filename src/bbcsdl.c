@@ -144,6 +144,10 @@ unsigned int palette[256] ;
 size_t iResult = 0 ;
 int bChanged = 0 ;
 int nUserEv = 0 ;
+VDUREC vduring[VDURING] ;
+int vduwi = 0 ;
+int vduri = 0 ;
+int vdubell = 0 ;
 int OSKtime = 6 ;
 SDL_Rect ClipRect ;
 SDL_Rect DestRect ;
@@ -1120,7 +1124,8 @@ static int maintick (void)
 	DestRect.h = sizey * scale ;
 #endif
 
-#define PAINT1 (((unsigned int)(now - lastpaint) >= PACER) && (nUserEv < MAXEV)) // Time window
+#define PAINT1 (((unsigned int)(now - lastpaint) >= PACER) && (nUserEv < MAXEV) && \
+		((vduwi - vduri) < MAXEV)) // Time window
 #define PAINT2 (reflag & 1) // Interpreter thread is waiting for refresh (vSync)
 #define PAINT3 ((unsigned int)(now - lastpaint) >= MAXFP) // Fallback minimum frame rate
 
@@ -1253,6 +1258,33 @@ static int maintick (void)
 				lastusrev = SDL_GetTicks() ;
 				break ;
 
+				case EVT_VDURUN :
+				SDL_AtomicSet ((SDL_atomic_t*) &vdubell, 0) ; // Before reading vduwi
+				while (vduri != SDL_AtomicGet ((SDL_atomic_t*) &vduwi))
+				    {
+					LPVDUREC rec = vduring + (vduri & (VDURING - 1)) ;
+					if (rec->code == EVT_VDU)
+						vduchr_ ((void *)(intptr_t) rec->data1) ;
+					else
+						xeqvdu_ ((void *)(intptr_t) rec->data2,
+							 (void *)(intptr_t) rec->data1, rec->code) ;
+					SDL_AtomicIncRef ((SDL_atomic_t*) &vduri) ;
+					if ((scroln > 0) || bBackground)
+						break ; // Paged mode may just have paused output
+					if ((unsigned int)(SDL_GetTicks() - now) >= PACER)
+						break ; // Leave time to refresh the display
+				    }
+				lastusrev = SDL_GetTicks() ;
+				if ((vduri != SDL_AtomicGet ((SDL_atomic_t*) &vduwi)) &&
+				    SDL_AtomicCAS ((SDL_atomic_t*) &vdubell, 0, 1))
+				    {
+					ev.user.code = EVT_VDURUN ;
+					SDL_AtomicIncRef ((SDL_atomic_t*) &nUserEv) ;
+					while (BBC_PushEvent (&ev) <= 0)
+						SDL_Delay (1) ;
+				    }
+				break ;
+
 				case EVT_COPYKEY :
 				iResult = copkey_ (ev.user.data1, ev.user.data2) ;
 				SDL_SemPost (Sema4) ;
@@ -1408,7 +1440,7 @@ static int maintick (void)
 				break ;
 
 				case WMU_TIMER :
-				if (nUserEv <= 0)
+				if ((nUserEv <= 0) && (vduri == vduwi))
 					flip7 () ;
 				if (timtrp)
 				{
@@ -11,6 +11,7 @@
 \*****************************************************************/
 
 #define __USE_MINGW_ANSI_STDIO 1
+#define _GNU_SOURCE
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -22,6 +23,17 @@
 #include <setjmp.h>
 #include "BBC.h"
 
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define NOTHREADS
+#elif !defined(PICO)
+#include <pthread.h>
+#endif
+#if !defined(PICO) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#endif
+
 #if defined __arm__ || defined __aarch64__ || defined __EMSCRIPTEN__ || defined __ANDROID__
 #define powl pow
 #define sqrtl sqrt
@@ -38,15 +50,21 @@
 #define EFORMAT "%.*E"
 #define FFORMAT "%.*f"
 #define GFORMAT "%.*G"
+typedef double variant ;
 #else
 #define EFORMAT "%.*LE"
 #define FFORMAT "%.*Lf"
 #define GFORMAT "%.*LG"
+typedef long double variant ;
 #endif
 
 // Routines in bbmain:
+void *intadr (char *) ;		// Get the address of an interpreter statistic
+int inprog (signed char *) ;	// Test for address in program or libraries
 void check (void) ;		// Check for running out of memory
 int range0 (char) ;		// Test char for valid in a variable name
+int range1 (char) ;		// Test char for valid in a variable name
+int range2 (char) ;		// Test char for valid at start of a variable name
 signed char nxt (void) ;	// Skip spaces, handle line continuation
 void error (int, const char*) ;	// Process an error
 void outchr (unsigned char) ;	// Output a character
@@ -96,6 +114,10 @@ long long geteof (void*) ;	// Get EOF status
 void *sysadr (char *) ;		// Get the address of an API function
 int getmodeno (void) ;		// Get the current MODE number
 
+// Array kernels (see below):
+int arrsum (VAR *, void *, int, unsigned char, int) ;
+int arrfun (void *, void *, int, unsigned char, signed char, signed char) ;
+
 // Global jump buffer:
 extern jmp_buf env ;
 
@@ -273,12 +295,81 @@ static unsigned long long number (int *pcount, int *ptrunc)
 	return n ;
 }
 
+// Cache of numeric constants in the program, keyed by address, so that
+// executing the same constant again skips the conversion.  The result also
+// depends on *HEX and *LOWERCASE so those are recorded too.  Entries stay
+// valid until clear().  Undefine CONCACHE to disable.
+#ifndef PICO
+#define CONCACHE 2048		// Number of entries (power of 2)
+#endif
+
+#ifdef CONCACHE
+typedef struct tagCONENT
+{
+	heapptr addr ;		// Address of constant in program (0 = unused)
+	unsigned char adv ;	// Length of constant in program
+	unsigned char mode ;	// Relevant bits of liston
+	VAR v ;			// Value of constant
+} CONENT ;
+
+static CONENT *contab ;		// Direct-mapped table
+#endif
+
+// Discard numeric-constant cache:
+void clrcon (void)
+{
+#ifdef CONCACHE
+	if (contab)
+		memset (contab, 0, CONCACHE * sizeof(CONENT)) ;
+#endif
+}
+
+#ifdef CONCACHE
+// Look up constant at esi, advancing past it if found, else return entry to fill:
+static CONENT *conget (int *hit)
+{
+	heapptr addr = esi - (signed char *) zero ;
+	CONENT *ent ;
+	*hit = 0 ;
+	if (!inprog (esi))
+		return NULL ;
+	if (contab == NULL)
+		contab = calloc (CONCACHE, sizeof(CONENT)) ;
+	if (contab == NULL)
+		return NULL ;
+	ent = contab + (addr & (CONCACHE - 1)) ;
+	if ((ent->addr == addr) && (ent->mode == (liston & (BIT2 | BIT3))))
+	    {
+		esi += ent->adv ;
+		*hit = 1 ;
+	    }
+	return ent ;
+}
+
+static void conput (CONENT *ent, signed char *p, VAR v)
+{
+	if ((ent == NULL) || ((esi - p) >= 256))
+		return ;
+	ent->addr = p - (signed char *) zero ;
+	ent->adv = esi - p ;
+	ent->mode = liston & (BIT2 | BIT3) ;
+	ent->v = v ;
+}
+#endif
+
 // Get an unsigned numeric constant:
 VAR con (void)
 {
 	VAR v ;
 	unsigned long long i = 0, f = 0 ;
 	int e = 0, ni, nf = 0, ne = 0, nt = 0 ;
+#ifdef CONCACHE
+	signed char *p = esi ;
+	int hit ;
+	CONENT *ent = conget (&hit) ;
+	if (hit)
+		return ent->v ;
+#endif
 	setfpu () ;
 
 	i = number (&ni, &nt) ;
@@ -332,6 +423,9 @@ VAR con (void)
 	    }
 
 	if (*esi == '#') esi++ ;
+#ifdef CONCACHE
+	conput (ent, p, v) ;
+#endif
 	return v ;
 }
 
@@ -553,6 +647,7 @@ void xfloat (VAR *px)
 
 static void float2 (VAR *px, VAR *py)
 {
+	setfpu () ;
 	if (px->i.t == 0)
 	    {
 		px->i.t = 1 ; // ARM
@@ -580,8 +675,6 @@ unsigned int rnd (void)
 
 VAR math (VAR x, signed char op, VAR y)
 {
-	errno = 0 ;
-	setfpu () ;
 	switch (op)
 	    {
 		case '+':
@@ -697,6 +790,7 @@ VAR math (VAR x, signed char op, VAR y)
 				    }
 			    }
 			float2 (&x, &y) ;
+			errno = 0 ;
 			x.f = powl(x.f, y.f) ;
 			break ;
 
@@ -840,7 +934,7 @@ VAR math (VAR x, signed char op, VAR y)
 			return x ;
 	    }
 
-	if (isinf(x.f) || isnan(x.f) || (x.i.t == -1) || errno)
+	if (isinf(x.f) || isnan(x.f) || (x.i.t == -1) || ((op == '^') && errno))
 	    {
 		if (op == '/')
 			error (18, NULL) ; // 'Division by zero'
@@ -1005,6 +1099,189 @@ static int dimfunc (void)
 	return ILOAD(ptr + 1 + n * 4) - 1 ;
 }
 
+// Find first occurrence of string q (length m) in string p (length n):
+static char *instr (char *p, int n, char *q, int m)
+{
+#ifndef _WIN32
+	return memmem (p, n, q, m) ; // Two-Way, vectorised in most C libraries
+#else
+	char *end = p + n - m ; // last possible match
+	char c = *q, d = *(q + m - 1) ;
+	while ((p = memchr (p, c, end - p + 1)) != NULL)
+	    {
+		if ((*(p + m - 1) == d) && (0 == memcmp (p, q, m)))
+			return p ;
+		if (p++ == end)
+			break ;
+	    }
+	return NULL ;
+#endif
+}
+
+// Test that the rest of the line contains no FN, USR or EVAL and
+// therefore cannot change the value of a variable:
+static int nosides (signed char *p)
+{
+	signed char al ;
+	while ((al = *p++) != 0x0D)
+		if ((al == TFN) || (al == TUSR) || (al == TEVAL))
+			return 0 ;
+	return 1 ;
+}
+
+// Cache of tokenised EVAL strings, keyed by their contents and *LOWERCASE.
+// Tokenising depends only on those, so entries never become invalid and
+// the least-recently-used entry is replaced when the cache is full.
+// Undefine EVALCACHE to disable, or set @noevalcache at run time.
+#ifndef PICO
+#define EVALCACHE 256		// Number of entries (power of 2, < 32768)
+#define EVALLEN 255		// Longest string cached
+#endif
+
+#ifdef EVALCACHE
+typedef struct tagEVALENT
+{
+	unsigned int hash ;
+	int len ;		// Length of the string (-1 = unused)
+	int toklen ;		// Length of the tokenised string including CR
+	unsigned char mode ;	// Relevant bits of liston
+	short chain ;		// Next entry in the same hash bucket (-1 = none)
+	short newer, older ;	// Neighbours in the LRU list (-1 = none)
+	char str[EVALLEN] ;	// The string
+	char tok[EVALLEN + 1] ;	// The tokenised string
+} EVALENT ;
+
+static EVALENT *evaltab ;
+static short evalbkt[EVALCACHE] ;	// First entry in each hash bucket
+static short evalnew, evalold ;		// Ends of the LRU list
+
+extern int noevalcache ;
+#endif
+
+unsigned int evalhit, evalmiss ;	// EVAL cache statistics
+
+#ifdef EVALCACHE
+// Move an entry to the most-recently-used end of the LRU list:
+static void evaluse (int i)
+{
+	EVALENT *ent = evaltab + i ;
+	if (i == evalnew)
+		return ;
+	evaltab[ent->newer].older = ent->older ;
+	if (ent->older >= 0)
+		evaltab[ent->older].newer = ent->newer ;
+	else
+		evalold = ent->newer ;
+	ent->newer = -1 ;
+	ent->older = evalnew ;
+	evaltab[evalnew].newer = i ;
+	evalnew = i ;
+}
+
+// Remove an entry from its hash bucket:
+static void evalfree (int i)
+{
+	EVALENT *ent = evaltab + i ;
+	short *p = evalbkt + (ent->hash & (EVALCACHE - 1)) ;
+	if (ent->len < 0)
+		return ;
+	while (*p != i)
+		p = &evaltab[*p].chain ;
+	*p = ent->chain ;
+	ent->len = -1 ;
+}
+
+static int evalini (void)
+{
+	int i ;
+	evaltab = malloc (EVALCACHE * sizeof(EVALENT)) ;
+	if (evaltab == NULL)
+		return 0 ;
+	for (i = 0; i < EVALCACHE; i++)
+	    {
+		evaltab[i].len = -1 ;
+		evaltab[i].newer = i - 1 ;
+		evaltab[i].older = (i < EVALCACHE - 1) ? i + 1 : -1 ;
+		evalbkt[i] = -1 ;
+	    }
+	evalnew = 0 ;
+	evalold = EVALCACHE - 1 ;
+	return 1 ;
+}
+#endif
+
+// Tokenise an EVAL string into dst, as fixs() followed by lexan (accs, dst, 0):
+static void evalex (VAR v, char *dst)
+{
+	int toklen ;
+#ifdef EVALCACHE
+	EVALENT *ent = NULL ;
+	if ((noevalcache == 0) && (v.s.l <= EVALLEN) && (evaltab || evalini ()))
+	    {
+		unsigned char mode = liston & BIT3 ;
+		unsigned int hash = 2166136261U ^ mode ;
+		char *p = v.s.p + zero ;
+		int i ;
+		for (i = 0; i < v.s.l; i++)
+			hash = (hash ^ (unsigned char) p[i]) * 16777619 ; // FNV-1a
+		for (i = evalbkt[hash & (EVALCACHE - 1)]; i >= 0; i = evaltab[i].chain)
+		    {
+			ent = evaltab + i ;
+			if ((ent->hash == hash) && (ent->len == v.s.l) && (ent->mode == mode) &&
+			    (memcmp (ent->str, p, v.s.l) == 0))
+			    {
+				evalhit++ ;
+				evaluse (i) ;
+				memcpy (dst, ent->tok, ent->toklen) ;
+				return ;
+			    }
+		    }
+		evalmiss++ ;
+		i = evalold ;
+		evalfree (i) ;
+		evaluse (i) ;
+		ent = evaltab + i ;
+		ent->hash = hash ;
+		ent->mode = mode ;
+		memcpy (ent->str, p, v.s.l) ; // before fixs(), as p may be in accs
+	    }
+#endif
+	fixs (v) ;
+	toklen = lexan (accs, dst, 0) - dst ;
+#ifdef EVALCACHE
+	if (ent && (toklen <= EVALLEN + 1))
+	    {
+		short *p = evalbkt + (ent->hash & (EVALCACHE - 1)) ;
+		memcpy (ent->tok, dst, toklen) ;
+		ent->toklen = toklen ;
+		ent->len = v.s.l ;
+		ent->chain = *p ;
+		*p = ent - evaltab ;
+	    }
+#endif
+}
+
+// Report an out-of-range result from a numeric function:
+static VAR fnchk (signed char al, VAR v)
+{
+	if (isinf(v.f) || isnan(v.f) || (v.i.t == -1) || errno)
+	    {
+		if ((al == TLN) || (al == TLOG))
+			error (22, NULL) ; // 'Logarithm range'
+		else if (al == TSQR)
+			error (21, NULL) ; // 'Negative root'
+		else if (al == TEXP)
+			error (24, NULL) ; // 'Exponent range'
+		else
+			error (20, NULL) ; // 'Number too big'
+	    }
+
+	if (v.i.t == 0)
+		v.i.n = 0 ; // Underflow
+
+	return v ;
+}
+
 VAR item (void)
 {
 	VAR v ;
@@ -1659,6 +1936,8 @@ VAR item (void)
 			v.i.t = 0 ;
 			v.i.n = 0 ;
 			type &= ~BIT6 ;
+			if (arrsum (&v, ptr, count, type, 1))
+				count = 0 ;
 			for (i = 0; i < count; i++)
 			    {
 				VAR x = loadn (ptr, type) ; // n.b. type can be 40
@@ -1726,6 +2005,8 @@ VAR item (void)
 				v.i.t = 0 ;
 				v.i.n = 0 ;
 				type &= ~BIT6 ;
+				if (arrsum (&v, ptr, count, type, 0))
+					count = 0 ;
 				while (count--)
 				    {
 #if !(defined(__GNUC__) && (__GNUC__ >= 7) || defined(__clang__) && (__clang_major__ >= 4))
@@ -1753,6 +2034,11 @@ VAR item (void)
 			    {
 				int n = 0 ;
 				type &= ~BIT6 ;
+				if (arrsum (&x, ptr, count, type, 0))
+				    {
+					n = x.i.n ;
+					count = 0 ;
+				    }
 				while (count--)
 				    {
 					x = loads (ptr, type) ;
@@ -1767,12 +2053,15 @@ VAR item (void)
 				int i, n = 0 ;
 				void *tmp = ptr ;
 				type &= ~BIT6 ;
-				for (i = 0 ; i < count; i++)
-				    {
-					x = loads (tmp, type) ;
-					tmp += 8 ;
-					n += x.s.l ;
-				    }
+				if (arrsum (&x, ptr, count, type, 0))
+					n = x.i.n ;
+				else
+					for (i = 0 ; i < count; i++)
+					    {
+						x = loads (tmp, type) ;
+						tmp += 8 ;
+						n += x.s.l ;
+					    }
 				v.s.t = -1 ;
 				v.s.l = n ;
 				v.s.p = alloct (n) - (char *) zero ;
@@ -1901,8 +2190,7 @@ VAR item (void)
 			signed char *oldesi ;
 			heapptr *oldesp ;
 			v = items () ;
-			fixs (v) ;
-			lexan (accs, accs, 0) ; // assumes string gets no longer
+			evalex (v, accs) ; // assumes string gets no longer
 			v.s.p = accs - (char *) zero ;
 			v.s.l += 1 ;
 			oldesp = pushs (v) ;
@@ -2113,12 +2401,31 @@ VAR item (void)
 		void __attribute__ ((noinline)) nestedINSTR(void)
 #endif
 			{
-			heapptr *oldesp ;
+			heapptr *oldesp = esp ;
 			int n = 0 ;
 			char *p ;
-			VAR x = exprs () ;
-			oldesp = pushs (x) ;
-			x.s.p = (char *) esp - (char *) zero ;
+			VAR x ;
+
+			// If the first parameter is a simple string variable, and the
+			// other parameters cannot change it, search it in place rather
+			// than copying it to the stack (not an array element, whose
+			// subscript would be evaluated again if this fails):
+			unsigned char type ;
+			signed char *savesi = esi ;
+			void *ptr = NULL ;
+			signed char *name = esi ;
+			if (range2 (*name))
+				while (range1 (*++name)) ;
+			if ((name != esi) && (*name == '$') && (*(name + 1) != '(') && nosides (esi))
+				ptr = getvar (&type) ;
+			if ((ptr == NULL) || (type != 136) || (nxt () != ','))
+			    {
+				esi = savesi ;
+				ptr = NULL ;
+				x = exprs () ;
+				pushs (x) ;
+				x.s.p = (char *) esp - (char *) zero ;
+			    }
 			comma () ;
 			v = exprs () ;
 			pushs (v) ;
@@ -2131,6 +2438,8 @@ VAR item (void)
 					n = 0 ;
 			    }
 			braket () ;
+			if (ptr != NULL)
+				memcpy (&x.s.p, ptr, 8) ; // may be unaligned
 
 			if ((x.s.l == 0) || (v.s.l == 0) || ((n + v.s.l) > x.s.l))
 			    {
@@ -2140,20 +2449,10 @@ VAR item (void)
 			    }
 			else
 			    {
-				p = x.s.p + n + (char *) zero ;
-				n = 0 ;
-				while (p != NULL)
-				    {
-					if (0 == memcmp (p, v.s.p + zero, v.s.l))
-					    {
-						n = p - (char *) zero - x.s.p + 1 ;
-						break ;
-					    }
-					p = memchr (p + 1, *(v.s.p + (char *) zero),
-							x.s.p + x.s.l - v.s.l + (char *) zero - p) ;
-				    }
+				p = instr (x.s.p + n + (char *) zero, x.s.l - n,
+						v.s.p + (char *) zero, v.s.l) ;
 				v.i.t = 0 ;
-				v.i.n = n ;
+				v.i.n = p ? p - (char *) zero - x.s.p + 1 : 0 ;
 				esp = oldesp ;
 			    }
 			}
@@ -2192,7 +2491,9 @@ VAR item (void)
 			memcpy (accs, v.s.p + zero, v.s.l) ;
 			*(accs + v.s.l) = 0 ;
 			v.i.t = 0 ;
-			v.i.n = (intptr_t) sysadr (accs) ;
+			v.i.n = (intptr_t) intadr (accs) ;
+			if (v.i.n == 0)
+				v.i.n = (intptr_t) sysadr (accs) ;
 			return v ;
 
 /*********************************** PROC **************************************/
@@ -2205,6 +2506,12 @@ VAR item (void)
 		case '&':
 			{
 			signed char *p = esi ;
+#ifdef CONCACHE
+			int hit ;
+			CONENT *ent = conget (&hit) ;
+			if (hit)
+				return ent->v ;
+#endif
 			v.i.n = 0 ;
 			while (1)
 			    {
@@ -2222,6 +2529,9 @@ VAR item (void)
 			if ((liston & BIT2) == 0)
 				v.i.n = (v.i.n << 32) >> 32 ;
 			v.i.t = 0 ;
+#ifdef CONCACHE
+			conput (ent, p, v) ;
+#endif
 			}
 			return v ;
 
@@ -2229,6 +2539,13 @@ VAR item (void)
 
 		case '%':
 			{
+#ifdef CONCACHE
+			signed char *p = esi ;
+			int hit ;
+			CONENT *ent = conget (&hit) ;
+			if (hit)
+				return ent->v ;
+#endif
 			signed char al = *esi++ ;
 			v.i.n = 0 ;
 			if ((al != '0') && (al != '1'))
@@ -2242,6 +2559,9 @@ VAR item (void)
 				v.i.n = (v.i.n << 32) >> 32 ;
 			v.i.t = 0 ;
 			esi-- ;
+#ifdef CONCACHE
+			conput (ent, p, v) ;
+#endif
 			}
 			return v ;
 
@@ -2352,22 +2672,109 @@ VAR item (void)
 			}
 	    }
 
-	if (isinf(v.f) || isnan(v.f) || (v.i.t == -1) || errno)
+	return fnchk (al, v) ;
+}
+
+// Apply one of the numeric functions SIN, COS, TAN, ASN, ACS, ATN, EXP,
+// LN, SQR, ABS or INT to a value, exactly as item() does:
+static VAR func (signed char al, VAR v)
+{
+	if (v.i.t == 0)
 	    {
-		if ((al == TLN) || (al == TLOG))
-			error (22, NULL) ; // 'Logarithm range'
-		else if (al == TSQR)
-			error (21, NULL) ; // 'Negative root'
-		else if (al == TEXP)
-			error (24, NULL) ; // 'Exponent range'
-		else
-			error (20, NULL) ; // 'Number too big'
+		if ((al == TABS) && (v.i.n != 0x8000000000000000))
+		    {
+			v.i.n = llabs (v.i.n) ;
+			return v ;
+		    }
+		v.i.t = 1 ; // ARM
+		v.f = v.i.n ;
 	    }
+	errno = 0 ;
+	switch (al)
+	    {
+		case TSIN: v.f = sinl (v.f) ; break ;
+		case TCOS: v.f = cosl (v.f) ; break ;
+		case TTAN: v.f = tanl (v.f) ; break ;
+		case TASN: v.f = asinl (v.f) ; break ;
+		case TACS: v.f = acosl (v.f) ; break ;
+		case TATN: v.f = atanl (v.f) ; break ;
+		case TEXP: v.f = expl (v.f) ; break ;
+		case TLN:  v.f = logl (v.f) ; break ;
+		case TSQR: v.f = sqrtl (v.f) ; break ;
 
-	if (v.i.t == 0)
-		v.i.n = 0 ; // Underflow
+		case TABS:
+			v.f = fabsl (v.f) ;
+			return v ;
 
-	return v ;
+		default: // TINT
+			{
+			long long tmp ;
+			v.f = floorl (v.f) ;
+			tmp = v.f ;
+			if (v.f == tmp)
+			    {
+				v.i.n = tmp ;
+				v.i.t = 0 ;
+			    }
+			}
+			return v ;
+	    }
+	return fnchk (al, v) ;
+}
+
+// If the expression is one of the functions accepted by func() applied to
+// a whole numeric array, e.g. SQR(b()), parse it and return the function's
+// token, setting *pptr and *ptype as getvar() would for the array itself;
+// otherwise return zero and leave esi unchanged:
+static signed char getfna (void **pptr, unsigned char *ptype)
+{
+	signed char al = *esi, *p = esi + 1 ;
+	int paren = 0 ;
+	void *ptr ;
+
+	if ((al != TSIN) && (al != TCOS) && (al != TTAN) && (al != TASN) &&
+	    (al != TACS) && (al != TATN) && (al != TEXP) && (al != TLN) &&
+	    (al != TSQR) && (al != TABS) && (al != TINT))
+		return 0 ;
+
+	// Look ahead for 'name()' so that nothing is evaluated twice:
+	while (*p == ' ') p++ ;
+	if (*p == '(')
+	    {
+		paren = 1 ;
+		p++ ;
+		while (*p == ' ') p++ ;
+	    }
+	if (!range0 (*p) || (*p == '(') || (*p == '.') || ((*p >= '0') && (*p <= '9')))
+		return 0 ;
+	while (range0 (*p) && (*p != '('))
+		p++ ;
+	if (*p++ != '(')
+		return 0 ;
+	while (*p == ' ') p++ ;
+	if (*p != ')')
+		return 0 ;
+
+	esi++ ;
+	if (paren)
+	    {
+		nxt () ;
+		esi++ ;
+	    }
+	nxt () ;
+	ptr = getvar (ptype) ;
+	if (ptr == NULL)
+		error (16, NULL) ; // 'Syntax error'
+	if (*ptype == 0)
+		error (26, NULL) ; // 'No such variable'
+	if (((*ptype & BIT6) == 0) || (*ptype >= 128))
+		error (6, NULL) ; // 'Type mismatch'
+	if (paren)
+		braket () ;
+	if (nxt () == '.')
+		error (16, NULL) ; // 'Syntax error'
+	*pptr = ptr ;
+	return al ;
 }
 
 // Check for relational or shift operator.
@@ -2406,70 +2813,66 @@ static signed char relop (void)
 //            (5) = <> <= >= > < << >> >>>
 //            (6) AND
 //            (7) EOR OR
+// Levels are numbered 5 (^) down to 0 (EOR OR) below.  Each operand is
+// parsed once and then combined by operator precedence, rather than being
+// passed up through one function per level.
 
-// Level 5: ^:
-static VAR expr5 (void)
+// Return level of dyadic operator, or -1 if none:
+static int oplevel (signed char op)
 {
-	VAR x = item () ;
-	signed char op = nxt () ;
-	if (x.s.t == -1)
-		return x ; // string
-	while (1) 
+	switch (op)
 	    {
-		if (op == '^')
-		    {
-			esi++ ;
-			VAR y = item () ;
-			if (y.s.t == -1)
-				error (6, NULL) ; // 'Type mismatch'
-			x = math (x, op, y) ;
-		    }
-		else
-			break ;
-		op = nxt () ;
+		case TOR:
+		case TEOR:
+			return 0 ;
+
+		case TAND:
+			return 1 ;
+
+		case '<':
+		case '=':
+		case '>':
+			return 2 ;
+
+		case '+':
+		case '-':
+		case TSUM:
+			return 3 ;
+
+		case '*':
+		case '/':
+		case TMOD:
+		case TDIV:
+			return 4 ;
+
+		case '^':
+			return 5 ;
 	    }
-	return x;
+	return -1 ;
 }
 
-// Level 4: *, /, MOD, DIV:
-static VAR expr4 (void)
+// Evaluate an expression containing operators of the given level or higher:
+static VAR exprp (int level)
 {
-	VAR x = expr5 () ;
-	if (x.s.t == -1)
-		return x ; // string
-	while (1) 
+	VAR x = item () ;
+	int top = 5 ; // Highest level permitted next
+	while (1)
 	    {
-		signed char op = *esi ;
-		if ((op == '*') || (op == '/') || (op == TMOD) || (op == TDIV))
-		    {
-			esi++ ;
-			VAR y = expr5 () ;
-			if (y.s.t == -1)
-				error (6, NULL) ; // 'Type mismatch'
-			x = math (x, op, y) ;
-		    }
-		else
+		signed char op = nxt () ;
+		int n = oplevel (op) ;
+		if ((n < level) || (n > top))
 			break ;
-	    }
-	return x;
-}
+		top = n ;
 
-// Level 3: +, -, SUM:
-static VAR expr3 (void)
-{
-	VAR x = expr4 () ;
-	if (x.s.t == -1)
-	    {
-		while (1)
+		if (x.s.t == -1) // string
 		    {
-			signed char op = *esi ;
 			if (op == '+') // concatenate strings
 			    {
 				char *tmp ;
 				heapptr *oldesp ;
 				esi++ ;
 				oldesp = pushs (x) ;
-				VAR y = expr4 () ;
+				VAR y = exprp (4) ;
 				if (y.s.t != -1)
 					error (6, NULL) ; // 'Type mismatch'
 				tmp = moves ((STR *) &y, x.s.l) ;
@@ -2478,141 +2881,1175 @@ static VAR expr3 (void)
 				x.s.p = tmp - (char *) zero ;
 				x.s.l += y.s.l ;
 			    }
+			else if (n == 2) // compare strings
+			    {
+				VAR y ;
+				int n, r ;
+				heapptr *oldesp ;
+
+				op = relop () ;
+				oldesp = pushs (x) ;
+				y = exprp (3) ;
+				if (y.s.t != -1)
+					error (6, NULL) ; // 'Type mismatch'
+
+				n = x.s.l ;
+				if (n > y.s.l)
+					n = y.s.l ;
+				r = memcmp (esp, y.s.p + zero, n) ;
+				if (r == 0)
+					r = (x.s.l > y.s.l) - (x.s.l < y.s.l) ;
+				esp = oldesp ;
+
+				switch (op)
+				    {
+					case '<':
+						x.i.n = -(r < 0) ;
+						break ;
+					case '=':
+						x.i.n = -(r == 0) ;
+						break ;
+					case '>':
+						x.i.n = -(r > 0) ;
+						break ;
+					case 'y':
+						x.i.n = -(r <= 0) ;
+						break ;
+					case 'z':
+						x.i.n = -(r != 0) ;
+						break ;
+					case '{':
+						x.i.n = -(r >= 0) ;
+						break ;
+					default:
+						error (16, NULL) ; // Syntax error
+				    }
+				x.i.t = 0 ;
+				top = 1 ; // these operators do not chain
+			    }
 			else
 				break ;
+			continue ;
 		    }
-		return x ;
-	    }
-	while (1) 
-	    {
-		signed char op = *esi ;
-		if ((op == '+') || (op == '-') || (op == TSUM))
+
+		VAR y ;
+		if (n == 2)
 		    {
-			esi++ ;
-			VAR y = expr4 () ;
-			if (y.s.t == -1)
-				error (6, NULL) ; // 'Type mismatch'
-			x = math (x, op, y) ;
+			op = relop () ;
+			y = exprp (3) ;
+			top = 1 ; // these operators do not chain
 		    }
 		else
-			break ;
-	    }
-	return x;
-}
-
-// Level 2: =, <, >, <>, <=, >=, <<, >>, >>>:
-// (these operators do not chain)
-static VAR expr2 (void)
-{
-	VAR x = expr3 () ;
-	signed char op = relop () ;
-	if (op == 0)
-		return x ;
-	if (x.s.t == -1)
-	    {
-		VAR y ;
-		int n, r ;
-		heapptr *oldesp ;
-
-		oldesp = pushs (x) ;
-		y = expr3 () ;
-		if (y.s.t != -1)
+		    {
+			esi++ ;
+			if (n == 5)
+				y = item () ;
+			else
+				y = exprp (n + 1) ;
+		    }
+		if (y.s.t == -1)
 			error (6, NULL) ; // 'Type mismatch'
+		x = math (x, op, y) ;
+	    }
+	return x ;
+}
 
-		n = x.s.l ;
-		if (n > y.s.l)
-			n = y.s.l ;
-		r = memcmp (esp, y.s.p + zero, n) ;
-		if (r == 0)
-			r = (x.s.l > y.s.l) - (x.s.l < y.s.l) ;
-		esp = oldesp ;
+// Level 0: OR, EOR:
+VAR expr (void)
+{
+	return exprp (0) ;
+}
+
+#ifndef PICO
+#define MAXTHR 64	// Maximum number of worker threads
+#define MATPAR 4000000	// Minimum multiply-adds for a multithreaded matrix product
+#define MATRB 16	// Rows of the result computed per block
+#define MATNB 2		// Columns of the result computed together
+
+extern int dotthreads ;
+
+#ifndef NOTHREADS
+typedef struct { void (*func) (void *) ; void *job ; } THRARG ;
+
+#ifdef _WIN32
+static DWORD WINAPI thread (void *param)
+#else
+static void *thread (void *param)
+#endif
+{
+	THRARG *arg = param ;
+	arg->func (arg->job) ;
+	return 0 ;
+}
+#endif
 
-		switch (op)
+// Run func on each of n jobs of the given size concurrently, the first on
+// the calling thread; a job for which a thread can't be created is run on
+// the calling thread instead:
+void parallel (void (*func) (void *), void *jobs, int size, int n)
+{
+	int i ;
+#ifdef NOTHREADS
+	for (i = 0; i < n; i++)
+		func ((char *) jobs + i * size) ;
+#else
+	THRARG arg[MAXTHR] ;
+#ifdef _WIN32
+	HANDLE handle[MAXTHR] ;
+#else
+	pthread_t handle[MAXTHR] ;
+#endif
+	int made[MAXTHR] ;
+	for (i = 1; i < n; i++)
+	    {
+		arg[i].func = func ;
+		arg[i].job = (char *) jobs + i * size ;
+#ifdef _WIN32
+		made[i] = (NULL != (handle[i] = CreateThread (NULL, 0, thread, arg + i, 0, NULL))) ;
+#else
+		made[i] = (0 == pthread_create (&handle[i], NULL, thread, arg + i)) ;
+#endif
+		if (!made[i])
+			func (arg[i].job) ;
+	    }
+	func (jobs) ;
+	for (i = 1; i < n; i++)
+		if (made[i])
 		    {
-			case '<':
-				x.i.n = -(r < 0) ;
-				break ;
-			case '=':
-				x.i.n = -(r == 0) ;
-				break ;
-			case '>':
-				x.i.n = -(r > 0) ;
-				break ;
-			case 'y':
-				x.i.n = -(r <= 0) ;
-				break ;
-			case 'z':
-				x.i.n = -(r != 0) ;
-				break ;
-			case '{':
-				x.i.n = -(r >= 0) ;
-				break ;
-			default:
-				error (16, NULL) ; // Syntax error
+#ifdef _WIN32
+			WaitForSingleObject (handle[i], INFINITE) ;
+			CloseHandle (handle[i]) ;
+#else
+			pthread_join (handle[i], NULL) ;
+#endif
 		    }
-		x.i.t = 0 ;
+#endif
+}
+
+// Get the number of threads to use, given a setting (0 = one per CPU):
+int threads (int setting)
+{
+	int n = setting ;
+	if (n <= 0)
+	    {
+#ifdef NOTHREADS
+		n = 1 ;
+#elif defined(_WIN32)
+		SYSTEM_INFO info ;
+		GetSystemInfo (&info) ;
+		n = info.dwNumberOfProcessors ;
+#else
+		n = sysconf (_SC_NPROCESSORS_ONLN) ;
+#endif
 	    }
-	else
+	if (n > MAXTHR)
+		n = MAXTHR ;
+	return n > 1 ? n : 1 ;
+}
+
+typedef struct tagMATJOB
+{
+	char *dst ;		// Result, rows x cols elements of type
+	char *a ;		// Left operand, rows x inner elements of type
+	char *bp ;		// Right operand packed by matmul()
+	int rows0, rows1 ;	// Rows of the result to calculate
+	int inner, cols ;
+	unsigned char type ;	// Type of all three arrays: 4, 8 or 40
+	int status ;		// 0 = done, 1 = integer overflow, 20 = 'Number too big'
+} MATJOB ;
+
+// Calculate rows rows0 to rows1-1 of a matrix product, MATRB rows by MATNB
+// columns at a time.  Each element is accumulated in the same order and
+// precision as by the scalar code, so the results are identical:
+#if defined(__GNUC__) && !defined(__clang__)
+__attribute__((optimize("no-associative-math")))
+#endif
+static void matjob (void *param)
+{
+	MATJOB *job = param ;
+	int size = job->type & TMASK ;
+	int nb = (job->cols + MATNB - 1) / MATNB ;
+	int i0, i, j, k, m ;
+
+	setfpu () ;
+	job->status = 0 ;
+	for (i0 = job->rows0; i0 < job->rows1; i0 += MATRB)
+	    for (j = 0; j < nb; j++)
+		for (i = i0; (i < i0 + MATRB) && (i < job->rows1); i++)
+		    {
+			char *a = job->a + (size_t) i * job->inner * size ;
+			char *d = job->dst + ((size_t) i * job->cols + j * MATNB) * size ;
+			int ncol = job->cols - j * MATNB ;
+			if (ncol > MATNB)
+				ncol = MATNB ;
+
+			if (job->type == 8)
+			    {
+				double *b = (double *) job->bp + (size_t) j * job->inner * MATNB ;
+				variant s[MATNB] = {0} ;
+				for (k = 0; k < job->inner; k++)
+				    {
+#ifdef __clang__
+#pragma clang fp reassociate(off)
+#endif
+					double x ;
+					memcpy (&x, a, 8) ;
+					for (m = 0; m < MATNB; m++)
+						s[m] += (variant) x * b[m] ;
+					a += 8 ;
+					b += MATNB ;
+				    }
+				for (m = 0; m < ncol; m++)
+				    {
+					double r = s[m] ;
+					unsigned long long n ;
+					memcpy (&n, &r, 8) ;
+					if (((n >> 52) & 0x7FF) == 0x7FF)
+					    {
+						job->status = 20 ;
+						return ;
+					    }
+					if ((n >> 32) == 0)
+						n = 0 ; // as storen()
+					memcpy (d, &n, 8) ;
+					d += 8 ;
+				    }
+			    }
+			else
+			    {
+				long long *b = (long long *) job->bp + (size_t) j * job->inner * MATNB ;
+				long long s[MATNB] = {0} ;
+				int over = 0 ;
+				for (k = 0; k < job->inner; k++)
+				    {
+					long long x ;
+					if (job->type == 4)
+						x = ILOAD(a) ;
+					else
+						memcpy (&x, a, 8) ;
+					for (m = 0; m < MATNB; m++)
+					    {
+						long long p ;
+						over |= __builtin_smulll_overflow (x, b[m], &p) ;
+						over |= __builtin_saddll_overflow (s[m], p, &s[m]) ;
+					    }
+					if (over)
+					    {
+						job->status = 1 ;
+						return ;
+					    }
+					a += size ;
+					b += MATNB ;
+				    }
+				for (m = 0; m < ncol; m++)
+				    {
+					if (job->type == 4)
+					    {
+						if (s[m] != (int) s[m])
+						    {
+							job->status = 20 ;
+							return ;
+						    }
+						ISTORE(d, s[m]) ;
+					    }
+					else
+						memcpy (d, &s[m], 8) ;
+					d += size ;
+				    }
+			    }
+		    }
+}
+
+// Test whether a double is one which loadn() and math() treat as a plain
+// double, i.e. not an integer (zero high word), infinity or NaN:
+static int dblok (char *p)
+{
+	unsigned int lo = ULOAD(p), hi = ULOAD(p + 4) ;
+	return ((hi != 0) || (lo == 0)) && ((hi & 0x7FF00000) != 0x7FF00000) ;
+}
+
+// Test whether two areas of memory overlap:
+static int overlap (void *p, size_t n, void *q, size_t m)
+{
+	return ((char *) p < (char *) q + m) && ((char *) q < (char *) p + n) ;
+}
+
+// Matrix product dst = a . b of # or % or %% arrays (a has rows x inner
+// elements, b inner x cols) using a cache-blocked kernel, multithreaded
+// for large products.  An integer overflow, after which the scalar code
+// would continue in floating point, returns zero so that the scalar code
+// can repeat the whole product.  So does a destination overlapping either
+// operand (expra() normally supplies a temporary), since b is packed and
+// the rows of a are shared between threads before any result is stored:
+static int matmul (void *dst, unsigned char type, void *a, void *b,
+			int rows, int inner, int cols, unsigned char type2)
+{
+	MATJOB jobs[MAXTHR] ;
+	int nb = (cols + MATNB - 1) / MATNB ;
+	int size = type & TMASK ;
+	int i, j, k, n, status = 0 ;
+	char *bp ;
+
+	if ((type != type2) || ((type != 4) && (type != 8) && (type != 40)) ||
+	    (rows <= 0) || (inner <= 0) || (cols <= 0))
+		return 0 ;
+
+	if (overlap (dst, (size_t) rows * cols * size, a, (size_t) rows * inner * size) ||
+	    overlap (dst, (size_t) rows * cols * size, b, (size_t) inner * cols * size))
+		return 0 ;
+
+	// Doubles which loadn() would treat as integers, infinities and NaNs
+	// are left to the scalar code:
+	if (type == 8)
 	    {
-		VAR y = expr3 () ;
-		if (y.s.t == -1)
-			error (6, NULL) ; // 'Type mismatch'
-		x = math (x, op, y) ;
+		for (i = 0; i < rows * inner; i++)
+			if (!dblok ((char *) a + (size_t) i * 8))
+				return 0 ;
+		for (i = 0; i < inner * cols; i++)
+			if (!dblok ((char *) b + (size_t) i * 8))
+				return 0 ;
 	    }
-	return x;
+
+	// Pack b into blocks of MATNB columns, so that the columns needed
+	// together are adjacent, zero-padding the last block:
+	bp = malloc ((size_t) nb * inner * MATNB * 8) ;
+	if (bp == NULL)
+		return 0 ;
+	for (j = 0; j < nb * MATNB; j++)
+		for (k = 0; k < inner; k++)
+		    {
+			long long n = 0 ;
+			if (j < cols)
+			    {
+				char *p = (char *) b + ((size_t) k * cols + j) * size ;
+				if (type == 4)
+					n = (int) ILOAD(p) ;
+				else
+					memcpy (&n, p, 8) ;
+			    }
+			memcpy (bp + ((size_t) (j / MATNB) * inner * MATNB + k * MATNB + j % MATNB) * 8,
+				&n, 8) ;
+		    }
+
+	n = 1 ;
+	if ((double) rows * inner * cols >= MATPAR)
+		n = threads (dotthreads) ;
+	if (n > rows)
+		n = rows ;
+	for (i = 0; i < n; i++)
+	    {
+		jobs[i].dst = dst ;
+		jobs[i].a = a ;
+		jobs[i].bp = bp ;
+		jobs[i].rows0 = (long long) rows * i / n ;
+		jobs[i].rows1 = (long long) rows * (i + 1) / n ;
+		jobs[i].inner = inner ;
+		jobs[i].cols = cols ;
+		jobs[i].type = type ;
+	    }
+	parallel (matjob, jobs, sizeof(MATJOB), n) ;
+	free (bp) ;
+
+	// A result out of range is an error whatever the scalar code would do
+	// after an overflow elsewhere, since that could only be another error:
+	for (i = 0; i < n; i++)
+		if (jobs[i].status > status)
+			status = jobs[i].status ;
+	if (status == 20)
+		error (20, NULL) ; // 'Number too big'
+	return status == 0 ;
 }
+#endif
 
-// Level 1: AND:
-static VAR expr1 (void)
+#if !defined(PICO) && (defined(__GNUC__) && (__GNUC__ >= 9) || defined(__clang__) && (__clang_major__ >= 7))
+#define ARRVEC 4	// Elements per block in whole-array arithmetic kernels (see vany)
+
+typedef int vint __attribute__ ((vector_size (ARRVEC * 4))) ;
+typedef long long vlong __attribute__ ((vector_size (ARRVEC * 8))) ;
+typedef unsigned long long vulong __attribute__ ((vector_size (ARRVEC * 8))) ;
+typedef double vdbl __attribute__ ((vector_size (ARRVEC * 8))) ;
+
+// Test whether any element of a mask is set (a macro because passing a
+// vector to a function may depend on the target ISA):
+#define vany(m) ({ vlong _m = (m) ; (_m[0] | _m[1] | _m[2] | _m[3]) != 0 ; })
+
+// Whole-array arithmetic: dst() = dst() op src(), or dst() op scalar if
+// src is NULL, a block of ARRVEC elements at a time.  A block for which the
+// result could differ from modify() in any way (overflow, zeros, very large
+// or small values, or on x86 a result which the 80-bit calculation would
+// round twice) is passed to modify() element by element instead, so the
+// results and errors are exactly those of the scalar path:
+static inline __attribute__((always_inline))
+void arrblk (char *dst, char *src, VAR v, long long s, int n, unsigned char type, signed char op)
 {
-	VAR x = expr2 () ;
-	if (x.s.t == -1)
-		return x ; // string
-	while (1)
+	const vlong sv = (vlong) {0} + s ;
+	const int size = type & TMASK ;
+	const int x87 = sizeof(v.f) > sizeof(double) ;
+	int i, k ;
+
+	for (i = 0; i + ARRVEC <= n; i += ARRVEC)
 	    {
-		signed char op = *esi ;
-		if (op == TAND)
+		int bad = 0 ;
+		char *p = dst + i * size ;
+		char *q = src ? src + i * size : NULL ;
+		switch (type)
 		    {
-			esi++ ;
-			VAR y = expr2 () ;
-			if (y.s.t == -1)
-				error (6, NULL) ; // 'Type mismatch'
-			x = math (x, op, y) ;
+			case 4:
+			    {
+				vint ai, bi ;
+				vlong a, b, r ;
+				memcpy (&ai, p, sizeof(vint)) ;
+				a = __builtin_convertvector (ai, vlong) ;
+				if (src)
+				    {
+					memcpy (&bi, q, sizeof(vint)) ;
+					b = __builtin_convertvector (bi, vlong) ;
+				    }
+				else
+					b = sv ;
+				switch (op)
+				    {
+					case '=': r = b ; break ;
+					case '+': r = a + b ; break ;
+					case '-': r = a - b ; break ;
+					default:  r = a * b ;
+				    }
+				ai = __builtin_convertvector (r, vint) ;
+				bad = vany (r != __builtin_convertvector (ai, vlong)) ;
+				if (!bad)
+					memcpy (p, &ai, sizeof(vint)) ;
+			    }
+			break ;
+
+			case 40:
+			    {
+				vlong a, b, r ;
+				memcpy (&a, p, sizeof(vlong)) ;
+				if (src)
+					memcpy (&b, q, sizeof(vlong)) ;
+				else
+					b = sv ;
+				switch (op)
+				    {
+					case '=':
+						r = b ;
+						break ;
+					case '+':
+						r = (vlong) ((vulong) a + (vulong) b) ;
+						bad = vany (((a ^ r) & (b ^ r)) < 0) ;
+						break ;
+					case '-':
+						r = (vlong) ((vulong) a - (vulong) b) ;
+						bad = vany (((a ^ b) & (a ^ r)) < 0) ;
+						break ;
+					default:
+						for (k = 0; k < ARRVEC; k++)
+						    {
+							long long t ;
+							bad |= __builtin_smulll_overflow (a[k], b[k], &t) ;
+							r[k] = t ;
+						    }
+				    }
+				if (!bad)
+					memcpy (p, &r, sizeof(vlong)) ;
+			    }
+			break ;
+
+			case 8:
+			    {
+				vdbl a, b, r ;
+				vlong ab, bb, rb, ea, eb, za, zb, m ;
+				memcpy (&ab, p, sizeof(vlong)) ;
+				if (src)
+					memcpy (&bb, q, sizeof(vlong)) ;
+				else
+					bb = sv ;
+				memcpy (&a, &ab, sizeof(vdbl)) ;
+				memcpy (&b, &bb, sizeof(vdbl)) ;
+				ea = (vlong) ((vulong) ab >> 52) & 0x7FF ;
+				eb = (vlong) ((vulong) bb >> 52) & 0x7FF ;
+				za = (ab << 1) == 0 ; // +0 or -0
+				zb = (bb << 1) == 0 ;
+
+				if (op == '=')
+				    {
+					// Integers (zero exponent) and infinities aren't simply copied:
+					bad = vany (((eb == 0) & ~zb) | (eb == 0x7FF)) ;
+					if (!bad)
+						memcpy (p, &bb, sizeof(vlong)) ;
+					break ;
+				    }
+
+				// Operands must be zero or between 2^-510 and 2^511, so
+				// no result can overflow or be denormal:
+				m = (((ea < 0x201) | (ea > 0x5FE)) & ~za) |
+				    (((eb < 0x201) | (eb > 0x5FE)) & ~zb) ;
+				switch (op)
+				    {
+					case '+':
+					case '-':
+						r = (op == '+') ? a + b : a - b ;
+						// On x86 the sum is exact in 80 bits (so rounded
+						// only once) if the exponents differ by at most 10:
+						if (x87)
+							m |= ~(za | zb) & ((ea - eb > 10) | (eb - ea > 10)) ;
+						break ;
+
+					case '*':
+						r = a * b ;
+						m |= za | zb ; // math() returns a zero operand
+						if (x87)
+						    {
+							// The 106-bit product is rounded twice differently
+							// only if the 64-bit rounding hits a 53-bit midpoint:
+							const long long mant = 0xFFFFFFFFFFFFFLL ;
+							vulong lo = (vulong) ((ab & mant) | (mant + 1)) *
+								    (vulong) ((bb & mant) | (mant + 1)) ;
+							m |= (vlong) (((lo & 0xFFFFFFFFFFFFFULL) - 0x7FF0000000000ULL)
+								<= 0x20000000000ULL) ;
+							m |= (vlong) (((lo & 0x1FFFFFFFFFFFFFULL) - 0xFFE0000000000ULL)
+								<= 0x40000000000ULL) ;
+						    }
+						break ;
+
+					default:
+						r = a / b ;
+						m |= za | zb ;
+						if (x87) // only a power-of-two divisor is certainly exact
+							m |= (bb & 0xFFFFFFFFFFFFFLL) != 0 ;
+				    }
+				memcpy (&rb, &r, sizeof(vlong)) ;
+				m |= rb == (long long) 0x8000000000000000ULL ; // math() returns +0
+				bad = vany (m) ;
+				if (!bad)
+					memcpy (p, &rb, sizeof(vlong)) ;
+			    }
+			break ;
 		    }
-		else
+
+		if (bad)
+			for (k = i; k < i + ARRVEC; k++)
+				modify (src ? loadn (src + k * size, type) : v,
+					dst + k * size, type, op) ;
+	    }
+
+	for (; i < n; i++)
+		modify (src ? loadn (src + i * size, type) : v, dst + i * size, type, op) ;
+}
+
+static void arrgen (char *dst, char *src, VAR v, long long s, int n, unsigned char type, signed char op)
+{
+	arrblk (dst, src, v, s, n, type, op) ;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+static void arravx (char *dst, char *src, VAR v, long long s, int n, unsigned char type, signed char op)
+{
+	arrblk (dst, src, v, s, n, type, op) ;
+}
+#endif
+
+// Perform dst() = dst() op src() or dst() = dst() op v for n elements if the
+// array type and operator are supported, otherwise return zero:
+int arrvec (void *dst, void *src, VAR v, int n, unsigned char type, signed char op)
+{
+	long long s = 0 ;
+
+	if ((op != '=') && (op != '+') && (op != '-') && (op != '*') &&
+	    ((op != '/') || (type != 8)))
+		return 0 ;
+
+	switch (type)
+	    {
+		case 4:
+			if ((src == NULL) && (v.i.t || (v.i.n != (int) v.i.n)))
+				return 0 ;
+			s = v.i.n ;
+			break ;
+
+		case 40:
+			if ((src == NULL) && v.i.t)
+				return 0 ;
+			s = v.i.n ;
+			break ;
+
+		case 8:
+			if (src == NULL)
+			    {
+				double d ;
+				if (op == '/') // the compiler might use a reciprocal
+					return 0 ;
+				if (v.i.t == 0)
+				    {
+					if ((v.i.n > 0x20000000000000LL) || (v.i.n < -0x20000000000000LL))
+						return 0 ;
+					d = v.i.n ;
+				    }
+				else
+				    {
+					d = v.f ;
+					if (d != v.f)
+						return 0 ; // not exactly representable
+				    }
+				memcpy (&s, &d, 8) ;
+			    }
 			break ;
+
+		default:
+			return 0 ;
 	    }
-	return x;
+
+#if defined(__x86_64__) || defined(__i386__)
+	if (__builtin_cpu_supports ("avx2"))
+		arravx (dst, src, v, s, n, type, op) ;
+	else
+#endif
+		arrgen (dst, src, v, s, n, type, op) ;
+	return 1 ;
 }
 
-// Level 0: OR, EOR:
-VAR expr (void)
+#define REDBLK 16384	// Elements per partial result of an array reduction
+#define REDPAR 1000000	// Minimum elements for a multithreaded reduction
+#define REDSTK 64	// Partial results held on the stack
+
+typedef unsigned char vbyte __attribute__ ((vector_size (ARRVEC))) ;
+
+typedef struct tagREDPART
 {
-	VAR x = expr1 () ;
-	if (x.s.t == -1)
-		return x ; // string
-	while (1) 
+	double s[ARRVEC], c[ARRVEC] ;	// Sums and their compensations (# arrays)
+	unsigned long long n ;		// Sum (integer arrays and string lengths)
+	unsigned long long m ;		// Bound, overflow or special-value flags
+} REDPART ;
+
+// Sum the elements of a block of an array, or their squares if sq is non-zero,
+// accumulating # elements with compensation (2Sum, and Dekker's product for
+// the rounding error of each square) in ARRVEC lanes.  Integer
+// sums wrap: the flags in r->m let arrsum() decide whether the scalar code
+// would have overflowed.  String arrays sum the lengths:
+#if defined(__GNUC__) && !defined(__clang__)
+__attribute__((optimize("no-associative-math", "fp-contract=off")))
+#endif
+static inline __attribute__((always_inline))
+void sumblk (char *p, int n, unsigned char type, int sq, REDPART *r)
+{
+	vulong sum = {0}, bound = {0}, flag = {0} ;
+	vdbl s = {0}, c = {0} ;
+	int i, k ;
+
+	for (i = 0; i + ARRVEC <= n; i += ARRVEC)
 	    {
-		signed char op = *esi ;
-		if ((op == TOR) || (op == TEOR))
+		vlong a ;
+		switch (type)
 		    {
-			esi++ ;
-			VAR y = expr1 () ;
-			if (y.s.t == -1)
-				error (6, NULL) ; // 'Type mismatch'
-			x = math (x, op, y) ;
+			case 1:
+			    {
+				vbyte b ;
+				memcpy (&b, p, sizeof(vbyte)) ;
+				a = __builtin_convertvector (b, vlong) ;
+			    }
+			break ;
+
+			case 4:
+			    {
+				vint b ;
+				memcpy (&b, p, sizeof(vint)) ;
+				a = __builtin_convertvector (b, vlong) ;
+			    }
+			break ;
+
+			case 8:
+			    {
+#ifdef __clang__
+#pragma clang fp reassociate(off)
+#endif
+				vulong u, e ;
+				vdbl x, t, z ;
+				memcpy (&x, p, sizeof(vdbl)) ;
+				memcpy (&u, p, sizeof(vulong)) ;
+				e = (u >> 52) & 0x7FF ;
+				flag |= (vulong) ((u >> 32) != 0) ;
+				u = u << 1 ;
+				if (sq)
+					bound |= (vulong) ((u != 0) & ((e - 0x20B) > (0x5F3 - 0x20B))) ;
+				else
+					bound |= (vulong) ((u != 0) & ((e - 1) > (0x7FE - 1))) ;
+				if (sq)
+				    {
+					t = x * 134217729.0 ; // 2^27 + 1
+					z = t - (t - x) ; // high half of x
+					t = x - z ; // low half
+					x = x * x ;
+					c += ((z * z - x) + 2 * z * t) + t * t ;
+				    }
+				t = s + x ;
+				z = t - s ;
+				c += (s - (t - z)) + (x - z) ;
+				s = t ;
+			    }
+			p += ARRVEC * 8 ;
+			continue ;
+
+			case 136:
+				memcpy (&a, p, sizeof(vlong)) ;
+				sum += (vulong) a >> 32 ;
+				p += ARRVEC * 8 ;
+				continue ;
+
+			default: // 40
+			    {
+				vlong m ;
+				memcpy (&a, p, sizeof(vlong)) ;
+				m = a < 0 ;
+				bound |= (vulong) ((a ^ m) - m) ;
+			    }
+		    }
+		if (sq)
+		    {
+			sum += (vulong) (a * a) ;
+			flag |= sum ;
+		    }
+		else
+			sum += (vulong) a ;
+		p += ARRVEC * (type & TMASK) ;
+	    }
+
+	// Remaining elements, one per lane:
+	for (k = 0; i < n; i++, k++)
+	    {
+		long long a ;
+		switch (type)
+		    {
+			case 1:
+				a = *(unsigned char *) p ;
+				break ;
+
+			case 4:
+				a = ILOAD(p) ;
+				break ;
+
+			case 8:
+			    {
+#ifdef __clang__
+#pragma clang fp reassociate(off)
+#endif
+				unsigned long long u ;
+				unsigned int e ;
+				double x, t, z ;
+				memcpy (&x, p, 8) ;
+				memcpy (&u, p, 8) ;
+				e = (u >> 52) & 0x7FF ;
+				flag[k] |= ((u >> 32) != 0) ;
+				u = u << 1 ;
+				if (sq)
+					bound[k] |= (u != 0) && ((e - 0x20B) > (0x5F3 - 0x20B)) ;
+				else
+					bound[k] |= (u != 0) && ((e - 1) > (0x7FE - 1)) ;
+				if (sq)
+				    {
+					t = x * 134217729.0 ; // 2^27 + 1
+					z = t - (t - x) ; // high half of x
+					t = x - z ; // low half
+					x = x * x ;
+					c[k] += ((z * z - x) + 2 * z * t) + t * t ;
+				    }
+				t = s[k] + x ;
+				z = t - s[k] ;
+				c[k] += (s[k] - (t - z)) + (x - z) ;
+				s[k] = t ;
+			    }
+			p += 8 ;
+			continue ;
+
+			case 136:
+				sum[k] += ULOAD(p + 4) ;
+				p += 8 ;
+				continue ;
+
+			default: // 40
+				memcpy (&a, p, 8) ;
+				bound[k] |= a < 0 ? -(unsigned long long) a : a ;
+		    }
+		if (sq)
+		    {
+			sum[k] += (unsigned long long) a * a ;
+			flag[k] |= sum[k] ;
 		    }
 		else
+			sum[k] += a ;
+		p += type & TMASK ;
+	    }
+
+	memcpy (r->s, &s, sizeof(vdbl)) ;
+	memcpy (r->c, &c, sizeof(vdbl)) ;
+	r->n = 0 ;
+	r->m = 0 ;
+	for (k = 0; k < ARRVEC; k++)
+	    {
+		if (sq && (type != 8) && __builtin_uaddll_overflow (r->n, sum[k], &r->n))
+			r->m |= 1ULL << 63 ;
+		if (!sq)
+			r->n += sum[k] ;
+		if (type == 8)
+			r->m |= (bound[k] ? 1 : 0) | (flag[k] ? 2 : 0) ;
+		else if (sq)
+			r->m |= flag[k] | ((bound[k] >> 31) ? 1ULL << 63 : 0) ;
+		else
+			r->m |= bound[k] ;
+	    }
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+__attribute__((optimize("no-associative-math", "fp-contract=off")))
+#endif
+static void sumgen (char *p, int n, unsigned char type, int sq, REDPART *r)
+{
+	sumblk (p, n, type, sq, r) ;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#if defined(__GNUC__) && !defined(__clang__)
+__attribute__((optimize("no-associative-math", "fp-contract=off")))
+#endif
+__attribute__((target("avx2")))
+static void sumavx (char *p, int n, unsigned char type, int sq, REDPART *r)
+{
+	sumblk (p, n, type, sq, r) ;
+}
+#endif
+
+typedef struct tagREDJOB
+{
+	void (*blk) (char *, int, unsigned char, int, REDPART *) ;
+	char *ptr ;		// First element of the whole array
+	REDPART *part ;		// Partial results, one per REDBLK elements
+	int blk0, blk1 ;	// Blocks to sum
+	int count ;		// Elements in the whole array
+	unsigned char type ;
+	int sq ;
+} REDJOB ;
+
+static void redjob (void *param)
+{
+	REDJOB *job = param ;
+	int b ;
+	for (b = job->blk0; b < job->blk1; b++)
+	    {
+		int n = job->count - b * REDBLK ;
+		if (n > REDBLK)
+			n = REDBLK ;
+		job->blk (job->ptr + (size_t) b * REDBLK * (job->type & TMASK), n,
+			  job->type, job->sq, job->part + b) ;
+	    }
+}
+
+// Sum the count elements of an array (type 1, 4, 8, 40 or 136), or if sq is
+// non-zero the squares of the numeric elements, into *pv as for SUM, MOD
+// and SUMLEN.  The partial results depend only on the array, not on the number
+// of threads, so the result is always the same.  Integer sums are exact and
+// identical to the scalar code; # sums are compensated and may differ from the
+// sequential 80-bit sum in the last place.  Where the scalar code would
+// overflow into floating point, or meets values it treats specially, return
+// zero so that it can do the whole sum itself:
+#if defined(__GNUC__) && !defined(__clang__)
+__attribute__((optimize("no-associative-math")))
+#endif
+int arrsum (VAR *pv, void *ptr, int count, unsigned char type, int sq)
+{
+	REDPART stk[REDSTK], *part = stk ;
+	REDJOB jobs[MAXTHR] ;
+	int nblk = (count + REDBLK - 1) / REDBLK ;
+	int i, k, n = 1 ;
+	unsigned long long m = 0, sum = 0 ;
+	VAR v ;
+
+	if ((count <= 0) || ((type != 1) && (type != 4) && (type != 8) &&
+	    (type != 40) && ((type != 136) || sq)))
+		return 0 ;
+
+	if (nblk > REDSTK)
+	    {
+		part = malloc (nblk * sizeof(REDPART)) ;
+		if (part == NULL)
+			return 0 ;
+	    }
+
+	if (count >= REDPAR)
+		n = threads (dotthreads) ;
+	if (n > nblk)
+		n = nblk ;
+	for (i = 0; i < n; i++)
+	    {
+#if defined(__x86_64__) || defined(__i386__)
+		jobs[i].blk = __builtin_cpu_supports ("avx2") ? sumavx : sumgen ;
+#else
+		jobs[i].blk = sumgen ;
+#endif
+		jobs[i].ptr = ptr ;
+		jobs[i].part = part ;
+		jobs[i].blk0 = (long long) nblk * i / n ;
+		jobs[i].blk1 = (long long) nblk * (i + 1) / n ;
+		jobs[i].count = count ;
+		jobs[i].type = type ;
+		jobs[i].sq = sq ;
+	    }
+	parallel (redjob, jobs, sizeof(REDJOB), n) ;
+
+	for (i = 0; i < nblk; i++)
+	    {
+		if (sq && (type != 8) && __builtin_uaddll_overflow (sum, part[i].n, &sum))
+			m |= 1ULL << 63 ;
+		if (!sq)
+			sum += part[i].n ;
+		m |= part[i].m ;
+	    }
+
+	v.i.t = 0 ;
+	v.i.n = sum ;
+	switch (type)
+	    {
+		case 8:
+			if (m & 1)
+				break ; // zero high word, subnormal, out of range, infinity or NaN
+			if (m & 2)
+			    {
+				// Neumaier's sum of the partial sums, in order:
+				variant s = 0, c = 0 ;
+				for (i = 0; i < nblk; i++)
+					for (k = 0; k < ARRVEC; k++)
+					    {
+						variant x = part[i].s[k], t = s + x ;
+						if (fabsl (s) >= fabsl (x))
+							c += (s - t) + x ;
+						else
+							c += (x - t) + s ;
+						s = t ;
+						c += part[i].c[k] ;
+					    }
+				s += c ;
+				if (isinf (s) || isnan (s))
+					break ; // the scalar code reports the error
+				v.i.t = 1 ; // ARM
+				v.f = s ;
+			    }
+			m = 0 ; // all zeros sum to integer zero
+			break ;
+
+		case 136:
+			v.i.n = (int) sum ;
+			m = 0 ;
+			break ;
+
+		case 40:
+			if (!sq)
+			    {
+				// No partial sum can have overflowed if count * max|x| < 2^63:
+				m = ((double) count * m >= 0x1p62) ;
+				break ;
+			    }
+			// fall through
+
+		default:
+			if (sq)
+				m = (m | sum) >> 63 ; // a partial sum overflowed
+			else
+				m = 0 ; // % and & sums can't overflow
+	    }
+
+	if (part != stk)
+		free (part) ;
+	if (m)
+		return 0 ;
+	*pv = v ;
+	return 1 ;
+}
+
+// Apply a function to one element, for blocks which the kernels can't do:
+static void funone (char *dst, char *src, unsigned char type, signed char fn)
+{
+	modify (func (fn, loadn (src, type)), dst, type, '=') ;
+}
+
+// Whole-array functions dst() = ABS(src()) or dst() = INT(src()), a block of
+// ARRVEC elements at a time.  As in arrblk(), a block containing a value
+// which func() treats specially (the most negative integer, an integer held
+// in a double, a subnormal, infinity or NaN) is passed to func() instead:
+static inline __attribute__((always_inline))
+void funblk (char *dst, char *src, int n, unsigned char type, signed char fn)
+{
+	const int size = type & TMASK ;
+	int i, k ;
+
+	for (i = 0; i + ARRVEC <= n; i += ARRVEC)
+	    {
+		int bad = 0 ;
+		char *p = dst + i * size ;
+		char *q = src + i * size ;
+		switch (type)
+		    {
+			case 4:
+			    {
+				vint a, m ;
+				memcpy (&a, q, sizeof(vint)) ;
+				if (fn == TABS)
+				    {
+					bad = vany (__builtin_convertvector (a, vlong) == -0x80000000LL) ;
+					m = a < 0 ;
+					a = (a ^ m) - m ;
+				    }
+				if (!bad)
+					memcpy (p, &a, sizeof(vint)) ;
+			    }
+			break ;
+
+			case 40:
+			    {
+				vlong a, m ;
+				memcpy (&a, q, sizeof(vlong)) ;
+				bad = vany (a == (long long) 0x8000000000000000ULL) ;
+				m = a < 0 ;
+				a = (a ^ m) - m ;
+				if (!bad)
+					memcpy (p, &a, sizeof(vlong)) ;
+			    }
 			break ;
+
+			case 8:
+			    {
+				vulong u, e, t ;
+				memcpy (&u, q, sizeof(vulong)) ;
+				e = (u >> 52) & 0x7FF ;
+				bad = vany ((e == 0x7FF) | ((e == 0) & ((u << 1) != 0))) ;
+				if (fn == TABS)
+					t = u & 0x7FFFFFFFFFFFFFFF ;
+				else
+				    {
+					// Clear the fraction bits, subtract one if any were
+					// set in a negative number, and make -0 +0 as func():
+					vlong be = (vlong) e - 1023 ;
+					vulong mask = (((vulong) {0} + 1) << (vulong) ((52 - be) & 63)) - 1 ;
+					vdbl r ;
+					mask = (mask & (vulong) ((be >= 0) & (be < 52))) |
+					       ((vulong) (be < 0) & 0x7FFFFFFFFFFFFFFF) ;
+					t = u & ~mask ;
+					memcpy (&r, &t, sizeof(vdbl)) ;
+					r -= (vdbl) ((vulong) (((vlong) u < 0) & ((u & mask) != 0)) &
+						     0x3FF0000000000000) ;
+					memcpy (&t, &r, sizeof(vdbl)) ;
+					t &= ~((vulong) (r == 0) & 0x8000000000000000) ;
+				    }
+				if (!bad)
+					memcpy (p, &t, sizeof(vulong)) ;
+			    }
+		    }
+		if (bad)
+			for (k = 0; k < ARRVEC; k++)
+				funone (p + k * size, q + k * size, type, fn) ;
+	    }
+
+	for ( ; i < n; i++)
+		funone (dst + i * size, src + i * size, type, fn) ;
+}
+
+static void fungen (char *dst, char *src, int n, unsigned char type, signed char fn)
+{
+	funblk (dst, src, n, type, fn) ;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// As funblk() and also dst#() = SQR(src#()).  Where the 80-bit square root
+// of func() is rounded to double twice, its result can differ from the
+// correctly-rounded vector square root, but only if the root is within an
+// 80-bit ulp of a point midway between two doubles.  The exact residual
+// x - r*r from an FMA measures that distance, and any block with a root
+// near such a point (or a power of two, or a value so small or large that
+// the test could underflow) is passed to func():
+__attribute__((target("avx2,fma")))
+static void funavx (char *dst, char *src, int n, unsigned char type, signed char fn)
+{
+	int i, k ;
+
+	if (fn != TSQR)
+	    {
+		funblk (dst, src, n, type, fn) ;
+		return ;
+	    }
+
+	for (i = 0; i + ARRVEC <= n; i += ARRVEC)
+	    {
+		const vulong sign = (vulong) {0} + 0x8000000000000000 ;
+		char *p = dst + i * 8 ;
+		char *q = src + i * 8 ;
+		vulong u, e, ru ;
+		vdbl x, r, res, ulp, d ;
+		int bad ;
+
+		memcpy (&u, q, sizeof(vulong)) ;
+		memcpy (&x, q, sizeof(vdbl)) ;
+		e = (u >> 52) & 0x7FF ;
+		r = (vdbl) _mm256_sqrt_pd ((__m256d) x) ;
+		res = (vdbl) _mm256_fnmadd_pd ((__m256d) r, (__m256d) r, (__m256d) x) ;
+		memcpy (&ru, &r, sizeof(vdbl)) ;
+		ulp = (vdbl) (ru & 0x7FF0000000000000) * r * 0x1p-52 ; // r * ulp(r)
+		d = (vdbl) ((vulong) res & ~sign) - ulp ;
+		bad = vany (((u << 1) != 0) & ((u >= sign) | (e < 0x100) | (e > 0x6FF) |
+			    ((ru & 0xFFFFFFFFFFFFF) == 0) |
+			    ((vdbl) ((vulong) d & ~sign) < ulp * 0x1p-9))) ;
+		if (bad)
+			for (k = 0; k < ARRVEC; k++)
+				funone (p + k * 8, q + k * 8, type, fn) ;
+		else
+			memcpy (p, &r, sizeof(vdbl)) ;
 	    }
-	return x;
+
+	for ( ; i < n; i++)
+		funone (dst + i * 8, src + i * 8, type, fn) ;
 }
+#endif
+
+// Perform dst() = fn(src()) for n elements if the array type and function
+// are supported, otherwise return zero:
+int arrfun (void *dst, void *src, int n, unsigned char type, signed char op, signed char fn)
+{
+	if ((op != '=') || ((type != 4) && (type != 8) && (type != 40)))
+		return 0 ;
+	if ((fn != TABS) && ((fn != TINT) || (type == 40)) && ((fn != TSQR) || (type != 8)))
+		return 0 ;
+
+#if defined(__x86_64__) || defined(__i386__)
+	if (__builtin_cpu_supports ("avx2") && __builtin_cpu_supports ("fma"))
+	    {
+		funavx (dst, src, n, type, fn) ;
+		return 1 ;
+	    }
+#endif
+	if (fn == TSQR)
+		return 0 ;
+	fungen (dst, src, n, type, fn) ;
+	return 1 ;
+}
+#else
+int arrvec (void *dst, void *src, VAR v, int n, unsigned char type, signed char op)
+{
+	return 0 ;
+}
+
+int arrfun (void *dst, void *src, int n, unsigned char type, signed char op, signed char fn)
+{
+	return 0 ;
+}
+
+int arrsum (VAR *pv, void *ptr, int count, unsigned char type, int sq)
+{
+	return 0 ;
+}
+#endif
 
 // Evaluate an array expression (strictly left-to-right):
 int expra (void *ebp, int ecx, unsigned char type)
 {
 	int i ;
-	signed char op ;
+	signed char op, fn ;
 	unsigned char type2 ;
 	void *ptr ;
 
@@ -2622,8 +4059,7 @@ int expra (void *ebp, int ecx, unsigned char type)
 		signed char *tmpesi ;
 		esi++ ;
 		VAR v = items () ;
-		fixs (v) ;
-		lexan (accs, buff, 0) ;
+		evalex (v, buff) ;
 		tmpesi = esi ;
 		esi = (signed char *) buff ;
 		count = expra (ebp, ecx, type) ; // recursive call
@@ -2647,7 +4083,9 @@ int expra (void *ebp, int ecx, unsigned char type)
 				op = '-' ;
 			    }
 
-			ptr = getvar (&type2) ;
+			fn = getfna (&ptr, &type2) ; // e.g. SQR(b())
+			if (fn == 0)
+				ptr = getvar (&type2) ;
 			if ((ptr != NULL) && (type2 & BIT6)) // RHS is an array
 			    {
 				if (ptr < (void *)2)
@@ -2661,9 +4099,14 @@ int expra (void *ebp, int ecx, unsigned char type)
 					error (6, NULL) ; // 'Type mismatch'
 				if (type < 128) // numeric array
 				    {
+					if ((type2 != type) || (fn ?
+					    !arrfun (ebp, ptr, ecx, type & ~BIT6, op, fn) :
+					    !arrvec (ebp, ptr, (VAR) {0}, ecx, type & ~BIT6, op)))
 					for (i = 0; i < ecx; i++)
 					    {
 						VAR v = loadn (ptr, type2 & ~BIT6) ;
+						if (fn)
+							v = func (fn, v) ;
 						modify (v, ebp, type & ~BIT6, op) ;
 						ebp += type & TMASK ; // GCC extension
 						ptr += type2 & TMASK ; // GCC extension
@@ -2691,24 +4134,26 @@ int expra (void *ebp, int ecx, unsigned char type)
 					    {
 						case TOR:
 						case TEOR:
-							v = expr1 () ;
+							v = exprp (1) ;
 							break ;
 
 						case TAND:
-							v = expr3 () ;
+							v = exprp (3) ;
 							break ;
 
 						case '+':
 						case '-':
-							v = expr4 () ;
+							v = exprp (4) ;
 							break ;
 
 						default:
-							v = expr5 () ;
+							v = exprp (5) ;
 					    }
 					if (v.s.t == -1)
 						error (6, NULL) ; // 'Type mismatch'
 
+					if ((nxt () == ',') ||
+					    !arrvec (ebp, NULL, v, ecx, type & ~BIT6, op))
 					for (i = 0; i < ecx; i++)
 					    {
 						modify (v, ebp, type & ~BIT6, op) ;
@@ -2798,6 +4243,10 @@ int expra (void *ebp, int ecx, unsigned char type)
 
 		type &= ~BIT6 ;
 		type2 &= ~BIT6 ;
+#ifndef PICO
+		if (matmul (ebp, type, ptr, rhs, rowsl, colsl, colsr, type2))
+			return ecx ;
+#endif
 		size = type2 & TMASK ;
 		for (i = 0; i < rowsl; i++)
 		    {
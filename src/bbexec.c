@@ -12,12 +12,14 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdint.h>
 #include <math.h>
 #include "BBC.h"
 
 // Routines in bbmain:
 int range1 (char) ;		// Test char for valid in a variable name
+int range2 (char) ;		// Test char for valid as first in a variable name
 signed char nxt (void) ;	// Skip spaces, handle line continuation
 void check (void) ;		// Check for running out of memory
 void error (int, const char*) ;	// Process an error
@@ -32,7 +34,9 @@ char *moves (STR *, int) ;	// Move string into temporary buffer
 void braket (void) ;		// Check for closing parenthesis
 void comma (void) ;		// Check for a comma
 void clear (void) ;		// Clear dynamic variables etc.
+void clrsym (void) ;		// Discard hashed symbol table
 void clrtrp (void) ;		// Clear ON event handlers
+void clridx (void) ;		// Discard libraries' line index
 signed char *findl (unsigned int) ;	// Find a specified line number or label
 int arrlen (void **) ;		// Count elements in an array
 void *getvar (unsigned char*) ;	// Get a variable's pointer and type
@@ -45,6 +49,7 @@ void *putdef (void *) ;
 signed char *gettop (signed char *, unsigned short *) ;
 signed char *search (signed char *, signed char) ;
 unsigned short setlin (signed char *, char **) ;
+int inprog (signed char *) ;	// Test for address in program or libraries
 
 // Routines in bbeval:
 VAR expr (void) ;		// Evaluate an expression
@@ -59,9 +64,11 @@ int str (VAR, char *, int) ;	// Convert number to decimal string
 int strhex (VAR, char*, int) ;	// Convert number to hexadecimal string
 void *channel (void) ;		// Get a file channel number
 int expra (void *, int, unsigned char) ; // Evaluate an array expression
+int arrvec (void *, void *, VAR, int, unsigned char, signed char) ; // Whole-array arithmetic
 VAR loadn (void *, unsigned char) ; // Load a numeric from memory
 VAR loads (void *, unsigned char) ; // Load a string from memory
 VAR math (VAR, signed char, VAR) ;  // Perform arithmetic
+void clrcon (void) ;		// Discard numeric-constant cache
 
 // Routines in bbcmos:
 heapptr xtrap (void) ;		// Handle an event interrupt etc.
@@ -328,6 +335,19 @@ void modifs (VAR v, void *ptr, unsigned char type, signed char op)
 	if (op != '+')
 		error (6, NULL) ; // 'Type mismatch'
 
+	if (type == 136)
+	    {
+		// Append in place if the existing allocation has room for it,
+		// otherwise allocs() moves it (allocations are powers of two):
+		char *dst ;
+		memcpy (&s.s.p, ptr, 8) ; // may be unaligned
+		dst = allocs ((STR *) ptr, s.s.l + v.s.l) ;
+		if (dst != s.s.p + zero)
+			memmove (dst, s.s.p + zero, s.s.l) ;
+		memmove (dst + s.s.l, v.s.p + zero, v.s.l) ;
+		return ;
+	    }
+
 	s = loads (ptr, type) ;
 	tmp = moves ((STR *) &v, s.s.l) ;
 	memmove (tmp, s.s.p + zero, s.s.l) ;
@@ -396,10 +416,204 @@ static void skip (void)
 	    }
 }
 
+// Jump-target cache for wsurch() and nsurch(), whose results depend only
+// on the program text and their arguments, so remain valid until clear()
+// or until a library or CALLed module is loaded or removed.
+// Undefine JMPCACHE to disable.
+#ifndef PICO
+#define JMPCACHE 4096		// Number of entries (power of 2)
+#endif
+
+#ifdef JMPCACHE
+typedef struct tagJMPENT
+{
+	heapptr from ;		// Start of search (0 = unused)
+	heapptr to ;		// Result of search (0 = not found)
+	unsigned int toks ;	// Tokens searched for
+	int level ;		// Initial nesting level
+} JMPENT ;
+
+static JMPENT *jmptab ;
+#endif
+
+// Dispatch tables for CASE statements whose WHEN clauses contain only
+// integer or string literals, built on first execution and discarded by
+// clrjmp() since they depend only on the program text.  A CASE with any
+// other WHEN value is marked so that it isn't scanned again, and is always
+// executed by evaluating each WHEN value in turn.
+// Undefine CASECACHE to disable.
+#ifndef PICO
+#define CASECACHE 256		// Number of CASE statements (power of 2)
+#endif
+
+#ifdef CASECACHE
+typedef struct tagCASEKEY
+{
+	long long key ;		// Integer value, or hash of string
+	heapptr str ;		// String literal (after the opening quote)
+	int len ;		// Length of string literal
+	int order ;		// Position in the CASE statement
+	heapptr to ;		// Where to continue if matched
+} CASEKEY ;
+
+typedef struct tagCASETAB
+{
+	heapptr at ;		// Line following CASE ... OF (0 = unused)
+	int num ;		// Number of keys (-1 = not all literals)
+	int str ;		// Keys are strings
+	heapptr other ;		// Where to continue if unmatched (after OTHERWISE or ENDCASE)
+	CASEKEY *keys ;		// Sorted by key, then order
+} CASETAB ;
+
+static CASETAB *casetab ;
+#endif
+
+// Table of the items in the program's DATA statements, built on the first
+// READ or RESTORE and discarded by clrjmp().  Each item is keyed by the
+// DATA pointer from which it is read (the DATA token or the preceding
+// comma), so READ normally finds the next item without searching, and
+// RESTORE finds the next DATA line by binary search.  String values are
+// copied straight from the program, and numeric literals are evaluated
+// the first time they are read; anything else is parsed as before.
+// Undefine DATCACHE to disable.
+#ifndef PICO
+#define DATCACHE
+#endif
+
+#ifdef DATCACHE
+typedef struct tagDATENT
+{
+	heapptr at ;		// DATA pointer before the item
+	heapptr str ;		// Start of string value in program
+	int len ;		// Length of string value
+	heapptr send ;		// DATA pointer after reading a string (0 = not cacheable)
+	heapptr nend ;		// DATA pointer after reading a number (0 = not yet read)
+	int lit ;		// Non-zero if a numeric literal
+	int nxl ;		// Index of first item on next DATA line (-1 = none)
+	VAR v ;			// Numeric value
+} DATENT ;
+
+static DATENT *dattab ;		// Items in program order
+static int datnum = -1 ;	// Number of items (-1 = not built)
+static int datmax ;		// Size of allocated table
+static int datidx ;		// Index of item expected to be read next
+static heapptr dattop ;		// End of program when table was built
+#endif
+
+// Formal parameter lists of DEF PROC and DEF FN, keyed by the address of
+// the list in the program.  A list is cached only if each parameter is a
+// plain variable, array or structure name, whose address can't change
+// until clear(), so a call needn't parse the list again.
+// Undefine PROCCACHE to disable.
+#ifndef PICO
+#define PROCCACHE 256		// Number of entries (power of 2)
+#endif
+#define PROCPAR 8		// Maximum number of parameters cached
+
+// A call of a FN or PROC in tail position shares the frame of the caller.
+// Undefine TAILCALL to disable.
+#ifndef PICO
+#define TAILCALL
+#define TAILMAX 64		// Maximum number of variables saved in the frame
+#endif
+
+typedef struct tagPROCPARM
+{
+	void *ptr ;		// Address of formal variable
+	unsigned char type ;	// Type of formal variable (from getput)
+	unsigned char ret ;	// Non-zero if RETURN parameter
+} PROCPARM ;
+
+typedef struct tagPROCENT
+{
+	heapptr at ;		// Formal parameter list, i.e. '(' (0 = unused)
+	heapptr end ;		// Following the closing bracket
+	int num ;		// Number of parameters
+	int nret ;		// Number of RETURN parameters
+	PROCPARM par[PROCPAR] ;
+} PROCENT ;
+
+#ifdef PROCCACHE
+static PROCENT *proctab ;
+#endif
+
+unsigned int jmphit, jmpmiss ;	// Jump-target cache statistics
+
+// Discard jump-target cache, CASE dispatch tables, DATA table and
+// PROC/FN parameter lists:
+void clrjmp (void)
+{
+#ifdef JMPCACHE
+	if (jmptab)
+		memset (jmptab, 0, JMPCACHE * sizeof(JMPENT)) ;
+#endif
+#ifdef CASECACHE
+	if (casetab)
+	    {
+		int i ;
+		for (i = 0; i < CASECACHE; i++)
+			free (casetab[i].keys) ;
+		memset (casetab, 0, CASECACHE * sizeof(CASETAB)) ;
+	    }
+#endif
+#ifdef DATCACHE
+	datnum = -1 ;
+#endif
+#ifdef PROCCACHE
+	if (proctab)
+		memset (proctab, 0, PROCCACHE * sizeof(PROCENT)) ;
+#endif
+}
+
+#ifdef JMPCACHE
+// Look up cached search starting at esi, return entry to fill if a miss:
+static JMPENT *jmpget (unsigned int toks, int level, int *hit)
+{
+	heapptr from = esi - (signed char *) zero ;
+	JMPENT *ent ;
+	*hit = 0 ;
+	if (!inprog (esi))
+		return NULL ;
+	if (jmptab == NULL)
+		jmptab = calloc (JMPCACHE, sizeof(JMPENT)) ;
+	if (jmptab == NULL)
+		return NULL ;
+	ent = jmptab + ((from ^ (toks * 31) ^ level) & (JMPCACHE - 1)) ;
+	if ((ent->from == from) && (ent->toks == toks) && (ent->level == level))
+	    {
+		jmphit++ ;
+		*hit = 1 ;
+		return ent ;
+	    }
+	jmpmiss++ ;
+	ent->from = 0 ;
+	return ent ;
+}
+
+static void jmpput (JMPENT *ent, unsigned int toks, int level, signed char *from, signed char *to)
+{
+	ent->to = to ? to - (signed char *) zero : 0 ;
+	ent->toks = toks ;
+	ent->level = level ;
+	ent->from = from - (signed char *) zero ;
+}
+#endif
+
 // Search forward for a token, which may be anywhere in a line
 // Handle nested inner structures (nest token ignored after EXIT)
 static void wsurch (signed char token, signed char nest, int level)
 {
+#ifdef JMPCACHE
+	unsigned int toks = (unsigned char) token | ((unsigned char) nest << 8) | 0x10000 ;
+	signed char *from = esi ;
+	int level0 = level, hit ;
+	JMPENT *ent = jmpget (toks, level, &hit) ;
+	if (hit)
+	    {
+		esi = ent->to + (signed char *) zero ;
+		return ;
+	    }
+#endif
 	while (1)
 	    {
 		signed char al = *esi++ ;
@@ -413,18 +627,22 @@ static void wsurch (signed char token, signed char nest, int level)
 			esi++ ;
 		    }
 		else if ((al == token) && (--level == 0))
-			return ; // found
+			break ; // found
 		else if (al == nest)
 			level++ ;
 		else if (al == 0x0D)
 		    {
 			if (*esi == 0)
-				return ; // not found
+				break ; // not found
 			esi += 3 ;
 			if (*esi == TDATA)
 				esi = memchr (esi, 0x0D, 255) ;
 		    }
 	    }
+#ifdef JMPCACHE
+	if (ent)
+		jmpput (ent, toks, level0, from, esi) ;
+#endif
 }
 
 // Search forward for one of two tokens at the start of a line.
@@ -434,23 +652,252 @@ static void wsurch (signed char token, signed char nest, int level)
 static signed char *nsurch (signed char tok1, signed char tok2,
 			signed char nest, signed char unnest, int level)
 {
+#ifdef JMPCACHE
+	unsigned int toks = (unsigned char) tok1 | ((unsigned char) tok2 << 8) |
+			((unsigned char) nest << 16) | ((unsigned int)(unsigned char) unnest << 24) ;
+	signed char *from = esi ;
+	int level0 = level, hit ;
+	JMPENT *ent = jmpget (toks, level, &hit) ;
+	if (hit)
+		return ent->to ? ent->to + (signed char *) zero : NULL ;
+#endif
+	signed char *ret ;
 	while (1)
 	    {
 		int n = (int)*(unsigned char*)esi ;
 		if (n == 0)
-			return NULL ; // Not found
+		    {
+			ret = NULL ; // Not found
+			break ;
+		    }
 		if ((level == 0) && ((tok1 == *(esi+3)) || (tok2 == *(esi+3))))
-			return esi ;
+		    {
+			ret = esi ;
+			break ;
+		    }
 		if (unnest == *(esi+3))
 			level-- ;
 		if (level < 0)
-			return esi ;
+		    {
+			ret = esi ;
+			break ;
+		    }
 		esi += n ;
 		if ((n > 4) && (nest == *(esi-2)))
 			level++ ;
 	    }
+#ifdef JMPCACHE
+	if (ent)
+		jmpput (ent, toks, level0, from, ret) ;
+#endif
+	return ret ;
+}
+
+#ifdef CASECACHE
+// Hash a string WHEN value or CASE expression:
+static unsigned long long casehash (const char *p, int n)
+{
+	unsigned long long hash = 14695981039346656037ULL ;
+	while (n--)
+		hash = (hash ^ (unsigned char) *p++) * 1099511628211ULL ; // FNV-1a
+	return hash ;
 }
 
+static int casecmp (const void *p, const void *q)
+{
+	const CASEKEY *a = p, *b = q ;
+	if (a->key != b->key)
+		return (a->key > b->key) - (a->key < b->key) ;
+	return a->order - b->order ;
+}
+
+// Parse an integer or string literal WHEN value, which must be of the same
+// kind as any before it (*str = -1 if none), followed by ',', ':' or CR:
+static int caselit (signed char **pq, CASEKEY *k, int *str)
+{
+	signed char *q = *pq ;
+	long long n = 0 ;
+	int neg = 0, digits = 0 ;
+
+	while (*q == ' ') q++ ;
+	if (*q == '"')
+	    {
+		signed char *s = ++q ;
+		if (*str == 0)
+			return 0 ;
+		while (*q != '"')
+			if (*q++ == 0x0D)
+				return 0 ;
+		if (*(q + 1) == '"')
+			return 0 ; // contains a quote
+		k->key = casehash ((char *) s, q - s) ;
+		k->str = s - (signed char *) zero ;
+		k->len = q - s ;
+		*str = 1 ;
+		q++ ;
+	    }
+	else
+	    {
+		if (*str == 1)
+			return 0 ;
+		if (*q == '-')
+		    {
+			neg = 1 ;
+			q++ ;
+		    }
+		if (*q == '&')
+		    {
+			q++ ;
+			while (((*q >= '0') && (*q <= '9')) || ((*q >= 'A') && (*q <= 'F')))
+			    {
+				n = n * 16 + *q - (*q >= 'A' ? 'A' - 10 : '0') ;
+				q++ ;
+				if (++digits > 7)
+					return 0 ;
+			    }
+		    }
+		else
+		    {
+			while ((*q >= '0') && (*q <= '9'))
+			    {
+				n = n * 10 + *q++ - '0' ;
+				if (++digits > 9)
+					return 0 ;
+			    }
+		    }
+		if (digits == 0)
+			return 0 ;
+		k->key = neg ? -n : n ;
+		*str = 0 ;
+	    }
+	while (*q == ' ') q++ ;
+	if ((*q != ',') && (*q != ':') && (*q != 0x0D))
+		return 0 ;
+	*pq = q ;
+	return 1 ;
+}
+
+// Build the dispatch table for the CASE statement whose WHEN clauses start
+// at esi, following the same search as the TCASE handler:
+static void casebld (CASETAB *tab)
+{
+	signed char *oldesi = esi ;
+	CASEKEY *keys = NULL ;
+	int level = 0, num = 0, max = 0, str = -1 ;
+
+	while (1)
+	    {
+		signed char *line = nsurch (TWHEN, TOTHERWISE, TOF, TENDCASE, level) ;
+		signed char *q ;
+		int i = num ;
+		if (line == NULL)
+			break ; // 'Missing ENDCASE' will be reported
+		q = line + 3 ;
+		if (*q++ != TWHEN)
+		    {
+			qsort (keys, num, sizeof(CASEKEY), casecmp) ;
+			tab->keys = keys ;
+			tab->num = num ;
+			tab->str = str ;
+			tab->other = q - (signed char *) zero ;
+			esi = oldesi ;
+			return ;
+		    }
+		while (1)
+		    {
+			if (num == max)
+			    {
+				CASEKEY *tmp = realloc (keys, (max = max * 2 + 16) * sizeof(CASEKEY)) ;
+				if (tmp == NULL)
+				    {
+					i = num ;
+					break ;
+				    }
+				keys = tmp ;
+			    }
+			if (!caselit (&q, keys + num, &str))
+			    {
+				i = num ; // not a literal
+				break ;
+			    }
+			keys[num].order = num ;
+			num++ ;
+			if (*q != ',')
+				break ;
+			q++ ;
+		    }
+		if (i == num)
+			break ;
+		while (i < num)
+			keys[i++].to = q - (signed char *) zero ;
+		esi = line + (int)*(unsigned char *)line ;
+		level = (*(esi - 2) == TOF) ;
+	    }
+	free (keys) ;
+	tab->keys = NULL ;
+	tab->num = -1 ;
+	esi = oldesi ;
+}
+
+// Look up the value of a CASE expression in the dispatch table for the
+// WHEN clauses starting at esi, returning where to continue and setting
+// *found if a WHEN matched, or returning NULL if there's no table:
+static signed char *caseget (VAR v, int *found)
+{
+	heapptr at = esi - (signed char *) zero ;
+	CASETAB *tab ;
+	long long key ;
+	int lo, hi ;
+
+	if (!inprog (esi))
+		return NULL ;
+	if (casetab == NULL)
+		casetab = calloc (CASECACHE, sizeof(CASETAB)) ;
+	if (casetab == NULL)
+		return NULL ;
+	tab = casetab + ((at ^ (at >> 12)) & (CASECACHE - 1)) ;
+	if (tab->at != at)
+	    {
+		free (tab->keys) ;
+		casebld (tab) ;
+		tab->at = at ;
+	    }
+	if ((tab->num < 0) || (tab->str != (v.s.t == -1)))
+		return NULL ; // not all literals, or 'Type mismatch' to report
+
+	*found = 0 ;
+	if (tab->str)
+		key = casehash (v.s.p + zero, v.s.l) ;
+	else if (v.i.t == 0)
+		key = v.i.n ;
+	else if ((v.f == truncl (v.f)) && (fabsl (v.f) < 0x1p62))
+		key = v.f ;
+	else
+		return tab->other + (signed char *) zero ; // can't equal an integer
+
+	lo = 0 ;
+	hi = tab->num ;
+	while (lo < hi)
+	    {
+		int mid = (lo + hi) / 2 ;
+		if (tab->keys[mid].key < key)
+			lo = mid + 1 ;
+		else
+			hi = mid ;
+	    }
+	for ( ; (lo < tab->num) && (tab->keys[lo].key == key); lo++)
+	    {
+		CASEKEY *k = tab->keys + lo ;
+		if (tab->str && ((k->len != v.s.l) ||
+		    memcmp (k->str + zero, v.s.p + zero, v.s.l)))
+			continue ;
+		*found = 1 ;
+		return k->to + (signed char *) zero ;
+	    }
+	return tab->other + (signed char *) zero ;
+}
+#endif
+
 // Get a (possibly quoted) string to string accumulator:
 static int fetchs (char **psrc)
 {
@@ -476,6 +923,168 @@ static int fetchs (char **psrc)
 	return dst - accs ;
 }
 
+#ifdef DATCACHE
+// Test whether the text of a DATA item is a numeric literal, whose value
+// doesn't depend on any variable or mode:
+static int datlit (signed char *p, signed char *q)
+{
+	int digits = 0 ;
+	for ( ; p < q; p++)
+	    {
+		if ((*p >= '0') && (*p <= '9'))
+			digits = 1 ;
+		else if (*p == 'E')
+		    {
+			if ((*(p - 1) != '.') && ((*(p - 1) < '0') || (*(p - 1) > '9')))
+				return 0 ;
+		    }
+		else if ((*p != '.') && (*p != ' ') && (*p != '+') && (*p != '-'))
+			return 0 ;
+	    }
+	return digits ;
+}
+
+// Build the table of DATA items, splitting each DATA line at commas in the
+// same way as fetchs().  Return zero if no memory:
+static int datbld (void)
+{
+	signed char *line = vpage + (signed char *) zero ;
+	int n, num = 0, prev = 0 ;
+
+	datidx = 0 ;
+	while ((n = (int)*(unsigned char *)line) != 0)
+	    {
+		signed char *q = line + 3 ;
+		int first = num ;
+		if (*q != TDATA)
+		    {
+			line += n ;
+			continue ;
+		    }
+		do
+		    {
+			DATENT *d ;
+			signed char *p ;
+			if (num == datmax)
+			    {
+				DATENT *tmp = realloc (dattab, (datmax = datmax * 2 + 256) * sizeof(DATENT)) ;
+				if (tmp == NULL)
+				    {
+					datmax = 0 ;
+					free (dattab) ;
+					dattab = NULL ;
+					return 0 ;
+				    }
+				dattab = tmp ;
+			    }
+			d = dattab + num++ ;
+			d->at = q - (signed char *) zero ;
+			d->nend = 0 ;
+			d->send = 0 ;
+			d->lit = 0 ;
+			p = ++q ;
+			while (*p == ' ') p++ ;
+			if (*p == '"')
+			    {
+				q = ++p ;
+				while ((*q != '"') && (*q != 0x0D))
+					q++ ;
+				if ((*q == 0x0D) || (*(q + 1) == '"'))
+					break ; // 'Missing "' or embedded quote
+				d->str = p - (signed char *) zero ;
+				d->len = q++ - p ;
+				while (*q == ' ') q++ ;
+				if (*q == '\\')
+					break ; // continuation line
+			    }
+			else
+			    {
+				q = p ;
+				while ((*q != ',') && (*q != 0x0D))
+					q++ ;
+				d->str = p - (signed char *) zero ;
+				d->len = q - p ;
+				d->lit = datlit (p, q) ;
+			    }
+			d->send = q - (signed char *) zero ;
+		    }
+		while (*q == ',') ;
+		while (prev < first)
+			dattab[prev++].nxl = first ;
+		line += n ;
+	    }
+	while (prev < num)
+		dattab[prev++].nxl = -1 ;
+	dattop = line - (signed char *) zero ;
+	datnum = num ;
+	return 1 ;
+}
+
+// Find the DATA item to be read from a given DATA pointer, or NULL:
+static DATENT *datget (heapptr at)
+{
+	int lo, hi ;
+	if ((datnum < 0) && !datbld ())
+		return NULL ;
+	if ((datidx < datnum) && (dattab[datidx].at == at))
+		return dattab + datidx ;
+	lo = 0 ;
+	hi = datnum ;
+	while (lo < hi)
+	    {
+		int mid = (lo + hi) / 2 ;
+		if (dattab[mid].at < at)
+			lo = mid + 1 ;
+		else
+			hi = mid ;
+	    }
+	if ((lo == datnum) || (dattab[lo].at != at))
+		return NULL ;
+	datidx = lo ;
+	return dattab + lo ;
+}
+
+// Set the DATA pointer after reading an item, skipping directly to the
+// next DATA line if the rest of this one would be ignored:
+static void datnxt (DATENT *d, heapptr end)
+{
+	signed char al = *(end + (signed char *) zero) ;
+	if (((al == 0x0D) || (al == ':')) && (d->nxl >= 0))
+	    {
+		datidx = d->nxl ;
+		datptr = dattab[datidx].at ;
+		return ;
+	    }
+	datidx = d - dattab + 1 ;
+	datptr = end ;
+}
+#endif
+
+// Find the first DATA statement at or after the start of a line:
+static signed char *datsrch (signed char *edi)
+{
+#ifdef DATCACHE
+	heapptr at = edi - (signed char *) zero ;
+	if ((at >= vpage) && ((datnum >= 0) || datbld ()) && (at <= dattop))
+	    {
+		int lo = 0, hi = datnum ;
+		while (lo < hi)
+		    {
+			int mid = (lo + hi) / 2 ;
+			if (dattab[mid].at < at)
+				lo = mid + 1 ;
+			else
+				hi = mid ;
+		    }
+		if (lo == datnum)
+			return NULL ;
+		datidx = lo ;
+		return dattab[lo].at + (signed char *) zero ;
+	    }
+#endif
+	return search (edi, TDATA) ;
+}
+
 // Test for being inside a function or procedure:
 static void isloc (void)
 {
@@ -813,8 +1422,9 @@ static void unret (void)
 	esp = edi ;
 }
 
-// Transfer actual parameters to formal parameters via the stack:
-static signed char* argue (signed char *ebx, heapptr *edi, int flag)
+// Transfer actual parameters to formal parameters via the stack,
+// taking the formal parameters from 'pe' if not NULL:
+static signed char* argue (signed char *ebx, heapptr *edi, int flag, const PROCENT *pe)
 {
 	int i, count = 0 ;
 	void *ptr ;
@@ -826,15 +1436,26 @@ static signed char* argue (signed char *ebx, heapptr *edi, int flag)
 	    {
 		unsigned char otype ;
 		void *optr ;
+		int ret ;
 
 		esi++ ;
 		ebx++ ;
-		if ((nxt () == TRETURN) || flag)
+		if (pe)
 		    {
-			if (*esi == TRETURN)
+			ret = pe->par[count].ret ;
+			ptr = pe->par[count].ptr ;
+			type = pe->par[count].type ;
+		    }
+		else
+		    {
+			ret = (nxt () == TRETURN) ;
+			if (ret)
 				esi++ ;
 			nxt () ;
 			ptr = getput (&type) ;
+		    }
+		if (ret || flag)
+		    {
 			if (type & BIT6)
 				type = ATYPE ;
 			*edi++ = (int)type ; // formal/private type
@@ -881,9 +1502,6 @@ static signed char* argue (signed char *ebx, heapptr *edi, int flag)
 		    }
 		else
 		    {
-
-			ptr = getput (&type) ;
-
 			tmp = esi ; esi = ebx ; ebx = tmp ; // swap
 			if (type & (BIT4 | BIT6))
 			    {
@@ -926,9 +1544,11 @@ static signed char* argue (signed char *ebx, heapptr *edi, int flag)
 		delim = nxt () ;
 		tmp = esi ; esi = ebx ; ebx = tmp ; // swap
 	    }
-	while ((nxt () == ',') && (delim == ',')) ;
-	if ((*esi == ',') || (delim == ','))
+	while ((pe ? (count < pe->num) : (nxt () == ',')) && (delim == ',')) ;
+	if ((pe ? (count < pe->num) : (*esi == ',')) || (delim == ','))
 		error (31, NULL) ; // 'Incorrect arguments'
+	if (pe)
+		esi = pe->end - 1 + (signed char *) zero ; // closing bracket
 
 	tmp = esi ; esi = ebx ; ebx = tmp ; // swap
 
@@ -1117,6 +1737,45 @@ static void defscan (signed char *edx)
 	    }
 }
 
+#ifdef PROCCACHE
+// Test whether a formal parameter is a plain variable, array or structure
+// name, i.e. not an array element, structure member or indirection:
+static int procsim (signed char *p, signed char *q)
+{
+	if (!range2 (*p))
+		return 0 ;
+	while ((p < q) && range1 (*p))
+		p++ ;
+	while ((p < q) && ((*p == '%') || (*p == '$') || (*p == '&') || (*p == '#')))
+		p++ ;
+	if ((p < q) && (((*p == '(') && (*(p + 1) == ')')) ||
+			((*p == '{') && (*(p + 1) == '}'))))
+		p += 2 ;
+	while ((p < q) && (*p == ' '))
+		p++ ;
+	return p == q ;
+}
+
+// Look up a formal parameter list, returning its entry, or an empty entry
+// to fill, or NULL.  Entries aren't replaced, because one may be in use
+// by a call whose actual parameters call another FN:
+static PROCENT *procget (signed char *list)
+{
+	heapptr at = list - (signed char *) zero ;
+	PROCENT *pe ;
+	if (!inprog (list))
+		return NULL ;
+	if (proctab == NULL)
+		proctab = calloc (PROCCACHE, sizeof(PROCENT)) ;
+	if (proctab == NULL)
+		return NULL ;
+	pe = proctab + ((at ^ (at >> 8)) & (PROCCACHE - 1)) ;
+	if (pe->at && (pe->at != at))
+		return NULL ;
+	return pe ;
+}
+#endif
+
 // User-defined PROC, ON PROC and FN:
 void procfn (signed char flag)
 {
@@ -1156,25 +1815,66 @@ void procfn (signed char flag)
 	if (nxt () == '(')
 	    {
 		int nret = 0 ;
+		PROCENT *pe = NULL, copy ;
 		oldesi = esi ;
 		esi = ebx ;
 		if (nxt () != '(')
 			error (16, NULL) ; // 'Syntax error'
-		do
+#ifdef PROCCACHE
+		pe = procget (esi) ;
+		if (pe && pe->at)
 		    {
-			esi++ ; // skip '(' or ','
-			unsigned char type ;
-			if (nxt () == TRETURN)
+			int i ;
+			for (i = 0; i < pe->num; i++)
+				savloc (pe->par[i].ptr, pe->par[i].type) ;
+			nret = pe->nret ;
+			esi = pe->end + (signed char *) zero ;
+		    }
+		else
+#endif
+		    {
+			signed char *list = esi ;
+			int num = 0 ;
+			do
 			    {
-				nret++ ;
-				esi++ ;
-				nxt () ;
+				esi++ ; // skip '(' or ','
+				unsigned char type ;
+				int ret = 0 ;
+				if (nxt () == TRETURN)
+				    {
+					nret++ ;
+					esi++ ;
+					nxt () ;
+					ret = 1 ;
+				    }
+				signed char *name = esi ;
+				ptr = getput (&type) ;
+				if (pe && (num < PROCPAR) && procsim (name, esi))
+				    {
+					pe->par[num].ptr = ptr ;
+					pe->par[num].type = type ;
+					pe->par[num].ret = ret ;
+				    }
+				else
+					pe = NULL ;
+				num++ ;
+				savloc (ptr, type) ;
+			    }
+			while (nxt () == ',') ;
+			braket () ;
+			if (pe)
+			    {
+				pe->num = num ;
+				pe->nret = nret ;
+				pe->end = esi - (signed char *) zero ;
+				pe->at = list - (signed char *) zero ;
 			    }
-			ptr = getput (&type) ;
-			savloc (ptr, type) ;
 		    }
-		while (nxt () == ',') ;
-		braket () ;
+		if (pe)
+		    {
+			copy = *pe ; // an actual parameter may call clrjmp()
+			pe = &copy ;
+		    }
 		edi = esp ; // pointer to saved parameters
 
 		check () ;
@@ -1183,7 +1883,7 @@ void procfn (signed char flag)
 		*--esp = RETCHK ;
 
 		esi = ebx ;
-		ebx = argue (oldesi, esp + 2, 0) + 1 ; // Transfer arguments
+		ebx = argue (oldesi, esp + 2, 0, pe) + 1 ; // Transfer arguments
 		braket() ;
 
 // If any of the dummy arguments are the same as passed-by-reference
@@ -1226,6 +1926,169 @@ void procfn (signed char flag)
 	esi = ebx ;
 }
 
+#ifdef TAILCALL
+// Size of a LOCAL or formal parameter save on the stack (see savloc):
+static int tailsiz (heapptr *p)
+{
+	unsigned char type = (unsigned char) *(int *)(p + 1) ;
+	if (type == STYPE)
+		return 2 + 3 * STRIDE ;
+	if (type < 128)
+		return 2 + STRIDE + 3 ;
+	if (type == 136)
+		return 2 + STRIDE + 2 ;
+	return 2 + STRIDE + 1 + ((*(int *)(p + 2 + STRIDE) + 3) >> 2) ;
+}
+
+// List the saves in the frame of the current FN or PROC starting at p,
+// following those already in ent[], and set *pchk to its FNCHK or PROCHK.
+// Return the new number of entries, or -1 if the frame holds anything
+// that must be undone on return other than saved variables:
+static int tailfrm (heapptr *p, int chk, heapptr **ent, int num, heapptr **pchk)
+{
+	heapptr *top = (heapptr *)((himem & -4) + zero) ;
+	while (p < top)
+	    {
+		int ebx = *(int *)p ;
+		if (ebx == chk)
+		    {
+			*pchk = p ;
+			return num ;
+		    }
+		if (ebx == LOCCHK)
+		    {
+			if (num == TAILMAX)
+				return -1 ;
+			ent[num++] = p ;
+			p += tailsiz (p) ;
+		    }
+		else if ((ebx == RETCHK) && (*(int *)(p + 1) == 0))
+			p += 2 ;
+		else if (ebx == FORCHK)
+			p += 9 + 2 * STRIDE ;
+		else if ((ebx == REPCHK) || (ebx == WHICHK))
+			p += 1 + STRIDE ;
+		else
+			return -1 ;
+	    }
+	return -1 ;
+}
+
+// Call the FN or PROC at esi (following the token) if the call is in tail
+// position, i.e. =FNx(...) at the end of a statement or PROCx(...) followed
+// by ENDPROC, and then merge the new frame into that of the current FN or
+// PROC.  A variable saved in both frames need only be restored from the
+// older save, so only one save per variable is kept and the stack doesn't
+// grow however deep the recursion.  Return zero if not a tail call:
+static int tailcall (int chk)
+{
+	heapptr *ent[TAILMAX] ;
+	void *var[TAILMAX] ;
+	heapptr *fr1, *fr2, *dst ;
+	signed char *p = esi ;
+	signed char *def ;
+	unsigned char found ;
+	void *ptr ;
+	int i, j, n, par = 0, level = 0 ;
+
+	if (*p == 0x18)
+		p += 3 ; // name index
+	else if (range1 (*p))
+		while (range1 (*p)) p++ ;
+	else
+		return 0 ;
+	if (*p == '(')
+		do
+		    {
+			signed char al = *p++ ;
+			if (al == '"')
+			    {
+				while (*p++ != '"')
+					if (*(p - 1) == 0x0D)
+						return 0 ;
+			    }
+			else if ((al >= 0x18) && (al <= 0x1F))
+				p += 2 ; // name or variable index
+			else if ((al == '(') || (al == TINSTR) || (al == TLEFT) || (al == TMID) ||
+				 (al == TRIGHT) || (al == TSTRING) || (al == TPOINT))
+				level++ ; // token includes '('
+			else if (al == ')')
+				level-- ;
+			else if (al == 0x0D)
+				return 0 ;
+		    }
+		while (level) ;
+	while (*p == ' ') p++ ;
+	if (chk == PROCHK)
+	    {
+		if (*p == 0x0D)
+		    {
+			if (*(p + 1) == 0)
+				return 0 ;
+			p += 3 ;
+		    }
+		else if (*p != ':')
+			return 0 ;
+		p++ ;
+		while (*p == ' ') p++ ;
+		if (*p != TENDPROC)
+			return 0 ;
+	    }
+	else if ((*p != ':') && (*p != 0x0D) && (*p != TELSE))
+		return 0 ;
+
+	p = esi-- ;
+	ptr = getdef (&found) ;
+	esi = p ;
+	if ((ptr == NULL) || (found == 0) || (ILOAD(ptr) == 0))
+		return 0 ;
+	def = VLOAD(ptr) ;
+	while (*def == ' ') def++ ;
+	if (*def == '(')
+	    {
+		for (par = 1; *def != ')'; def++)
+		    {
+			if ((*def == TRETURN) || (*def == 0x0D))
+				return 0 ;
+			if (*def == ',')
+				par++ ;
+			if ((*def >= 0x19) && (*def <= 0x1F))
+				def += 2 ; // variable index
+		    }
+	    }
+
+	n = tailfrm (esp, chk, ent, 0, &fr1) ;
+	if ((n < 0) || ((n + par) > TAILMAX))
+		return 0 ;
+
+	procfn (chk == FNCHK ? TFN : TPROC) ;
+
+	n = tailfrm (esp, chk, ent, 0, &fr2) ;
+	n = tailfrm (fr2 + 1 + STRIDE, chk, ent, n, &fr1) ;
+	for (i = 0; i < n; i++)
+		var[i] = *(void **)(ent[i] + 2) ;
+
+	dst = fr1 ;
+	for (i = n - 1; i >= 0; i--)
+	    {
+		int size = tailsiz (ent[i]) ;
+		for (j = n - 1; j > i; j--)
+			if (var[j] == var[i])
+				break ;
+		if (j > i)
+		    {
+			if ((unsigned char) *(int *)(ent[i] + 1) == 136)
+				allocs ((STR *)(ent[i] + 2 + STRIDE), 0) ; // discard saved string
+			continue ;
+		    }
+		dst -= size ;
+		memmove (dst, ent[i], size * sizeof(heapptr)) ;
+	    }
+	esp = dst ;
+	return 1 ;
+}
+#endif
+
 // Process end-of-line:
 void newlin (void)
 {
@@ -1251,10 +2114,113 @@ void newlin (void)
 }
 
 // Execute the program:
+// Statement dispatch through a table of label addresses (a GCC/Clang
+// extension) rather than the switch, selected by compiling with -DTHREADED.
+// The switch is still there, so 'break' works as usual:
+#if defined (THREADED) && (!defined (__GNUC__) || defined (REDUCE_STACK_SIZE))
+#undef THREADED
+#endif
+#ifdef THREADED
+#define LABEL(name) L_##name:
+#else
+#define LABEL(name)
+#endif
+
 VAR xeq (void)
 {
 	signed char al ;
 	void *tmpesi ;
+#ifdef THREADED
+	static void *const xeqtab[256] = {
+		[0 ... 255] = &&L_default,
+		[':'] = &&L_colon,
+		[(unsigned char) TENDIF] = &&L_TENDIF,
+		[(unsigned char) TENDCASE] = &&L_TENDCASE,
+		[(unsigned char) TSTOP] = &&L_TSTOP,
+		[(unsigned char) TEND] = &&L_TEND,
+		[0] = &&L_nul,
+		[(unsigned char) TWHEN] = &&L_TWHEN,
+		[(unsigned char) TOTHERWISE] = &&L_TOTHERWISE,
+		[(unsigned char) TQUIT] = &&L_TQUIT,
+		[(unsigned char) TREM] = &&L_TREM,
+		[(unsigned char) TDEF] = &&L_TDEF,
+		[(unsigned char) TDATA] = &&L_TDATA,
+		[(unsigned char) TELSE] = &&L_TELSE,
+		[(unsigned char) TLINO] = &&L_TLINO,
+		[(unsigned char) TGOTO] = &&L_TGOTO,
+		[(unsigned char) TGOSUB] = &&L_TGOSUB,
+		[(unsigned char) TRETURN] = &&L_TRETURN,
+		[(unsigned char) TPROC] = &&L_TPROC,
+		[(unsigned char) TLOCAL] = &&L_TLOCAL,
+		[(unsigned char) TPRIVATE] = &&L_TPRIVATE,
+		[(unsigned char) TENDPROC] = &&L_TENDPROC,
+		['='] = &&L_equals,
+		[(unsigned char) TRESTOR] = &&L_TRESTOR,
+		[(unsigned char) TCALL] = &&L_TCALL,
+		[(unsigned char) TINSTALL] = &&L_TINSTALL,
+		[(unsigned char) TTRACE] = &&L_TTRACE,
+		[(unsigned char) TBPUT] = &&L_TBPUT,
+		[(unsigned char) TPTRL] = &&L_TPTRL,
+		[(unsigned char) TEXTR] = &&L_TEXTR,
+		[(unsigned char) TPAGEL] = &&L_TPAGEL,
+		[(unsigned char) TLOMEML] = &&L_TLOMEML,
+		[(unsigned char) THIMEML] = &&L_THIMEML,
+		[(unsigned char) TRUN] = &&L_TRUN,
+		[(unsigned char) TCHAIN] = &&L_TCHAIN,
+		[(unsigned char) TREAD] = &&L_TREAD,
+		[(unsigned char) TINPUT] = &&L_TINPUT,
+		[(unsigned char) TPRINT] = &&L_TPRINT,
+		[(unsigned char) TWIDTH] = &&L_TWIDTH,
+		[(unsigned char) TCLOSE] = &&L_TCLOSE,
+		[(unsigned char) TOFF] = &&L_TOFF,
+		[(unsigned char) TERROR] = &&L_TERROR,
+		[(unsigned char) TCLEAR] = &&L_TCLEAR,
+		[(unsigned char) TVDU] = &&L_TVDU,
+		[(unsigned char) TCLS] = &&L_TCLS,
+		[(unsigned char) TCLG] = &&L_TCLG,
+		[(unsigned char) TMODE] = &&L_TMODE,
+		[(unsigned char) TCOLOUR] = &&L_TCOLOUR,
+		[(unsigned char) TGCOL] = &&L_TGCOL,
+		[(unsigned char) TTINT] = &&L_TTINT,
+		[(unsigned char) TMOVE] = &&L_TMOVE,
+		[(unsigned char) TDRAW] = &&L_TDRAW,
+		[(unsigned char) TFILL] = &&L_TFILL,
+		[(unsigned char) TLINE] = &&L_TLINE,
+		[(unsigned char) TORIGIN] = &&L_TORIGIN,
+		[(unsigned char) TPLOT] = &&L_TPLOT,
+		[(unsigned char) TCIRCLE] = &&L_TCIRCLE,
+		[(unsigned char) TELLIPSE] = &&L_TELLIPSE,
+		[(unsigned char) TRECT] = &&L_TRECT,
+		[(unsigned char) TIF] = &&L_TIF,
+		[(unsigned char) TON] = &&L_TON,
+		[(unsigned char) TFOR] = &&L_TFOR,
+		[(unsigned char) TNEXT] = &&L_TNEXT,
+		[(unsigned char) TREPEAT] = &&L_TREPEAT,
+		[(unsigned char) TUNTIL] = &&L_TUNTIL,
+		[(unsigned char) TWHILE] = &&L_TWHILE,
+		[(unsigned char) TENDWHILE] = &&L_TENDWHILE,
+		[(unsigned char) TEXIT] = &&L_TEXIT,
+		[(unsigned char) TSWAP] = &&L_TSWAP,
+		[(unsigned char) TCASE] = &&L_TCASE,
+		[(unsigned char) TTIMEL] = &&L_TTIMEL,
+		[(unsigned char) TWAIT] = &&L_TWAIT,
+		[(unsigned char) TREPORT] = &&L_TREPORT,
+		[(unsigned char) TMOUSE] = &&L_TMOUSE,
+		[(unsigned char) TSYS] = &&L_TSYS,
+		[(unsigned char) TOSCLI] = &&L_TOSCLI,
+		[(unsigned char) TSOUND] = &&L_TSOUND,
+		[(unsigned char) TENVEL] = &&L_TENVEL,
+		[(unsigned char) TDIM] = &&L_TDIM,
+		['('] = &&L_label,
+		['*'] = &&L_star,
+		['['] = &&L_assembler,
+		[0x0D] = &&L_eol,
+		[(unsigned char) TLEFT] = &&L_TLEFT,
+		[(unsigned char) TRIGHT] = &&L_TRIGHT,
+		[(unsigned char) TMID] = &&L_TMID,
+		[(unsigned char) TLET] = &&L_TLET,
+	} ;
+#endif
 	while (1) // for each statement
 	    {
 		__label__ xeq1 ;
@@ -1279,6 +2245,9 @@ VAR xeq (void)
 		curlin = esi - (signed char *) zero ;
 		while (*++esi == ' ') ;
 
+#ifdef THREADED
+		goto *xeqtab[(unsigned char) al] ;
+#endif
 		switch (al)
 		    {
 #if defined (REDUCE_STACK_SIZE) && defined(__GNUC__) && !defined(__llvm__)
@@ -1309,14 +2278,14 @@ VAR xeq (void)
 		auto void nestedENVEL(void);
 		auto void nestedSLICE(void);
 #endif
-			case ':':
+			case ':': LABEL(colon)
 				goto xeq1 ;
 
-			case TENDIF:
-			case TENDCASE:
+			case TENDIF: LABEL(TENDIF)
+			case TENDCASE: LABEL(TENDCASE)
 				break ;
 
-			case TSTOP:
+			case TSTOP: LABEL(TSTOP)
 				{
 				unsigned short lino = setlin (esi, NULL) ;
 				text ("\r\nSTOP") ;
@@ -1329,21 +2298,21 @@ VAR xeq (void)
 				error (256, NULL) ;
 				}
 
-			case TEND:
+			case TEND: LABEL(TEND)
 				osshut (0) ;
-			case 0:
+			case 0: LABEL(nul)
 				error (256, NULL) ;
 
 /************************************ WHEN *************************************/
 /********************************** OTHERWISE **********************************/
 
-			case TWHEN:
-			case TOTHERWISE:
+			case TWHEN: LABEL(TWHEN)
+			case TOTHERWISE: LABEL(TOTHERWISE)
 				error (44, NULL) ; // 'WHEN/OTHERWISE not first'
 
 /************************************ QUIT *************************************/
 
-			case TQUIT:
+			case TQUIT: LABEL(TQUIT)
 				{
 				int n = 0 ;
 				if (!termq ())
@@ -1353,20 +2322,20 @@ VAR xeq (void)
 
 /************************************* REM *************************************/
 
-			case TREM:
-			case TDEF:
-			case TDATA:
-			case TELSE:
+			case TREM: LABEL(TREM)
+			case TDEF: LABEL(TDEF)
+			case TDATA: LABEL(TDATA)
+			case TELSE: LABEL(TELSE)
 				esi = (signed char*) memchr ((char *) esi, 0x0D, 255) ;
 				break ;
 
 /************************************ GOTO *************************************/
 /************************************ GOSUB ************************************/
 
-			case TLINO:
+			case TLINO: LABEL(TLINO)
 				esi = tmpesi ;
-			case TGOTO:
-			case TGOSUB:
+			case TGOTO: LABEL(TGOTO)
+			case TGOSUB: LABEL(TGOSUB)
 				{
 				int n = itemi () ;
 				if (al == TGOSUB)
@@ -1387,7 +2356,7 @@ VAR xeq (void)
 
 /*********************************** RETURN ************************************/
 
-			case TRETURN:
+			case TRETURN: LABEL(TRETURN)
 				while (*(int *)esp != GOSCHK)
 				    {
 					int ebx = *(int *)esp ;
@@ -1422,6 +2391,10 @@ VAR xeq (void)
 #ifdef PICO
 						libtop = ebx ;
 #endif
+						clrsym () ; // its addresses will be reused
+						clrcon () ;
+						clrjmp () ;
+						clridx () ;
 					    }
 					else
 						error (38, NULL) ; // 'Not in a subroutine'
@@ -1444,15 +2417,19 @@ VAR xeq (void)
 
 /************************************ PROC *************************************/
 
-			case TPROC:
+			case TPROC: LABEL(TPROC)
 				if (*(esi-1) == ' ')
 					error (30, NULL) ; // 'Bad call'
+#ifdef TAILCALL
+				if (tailcall (PROCHK))
+					break ;
+#endif
 				procfn (TPROC) ;
 				break ;
 
 /************************************ LOCAL ************************************/
 
-			case TLOCAL:
+			case TLOCAL: LABEL(TLOCAL)
 #if defined (REDUCE_STACK_SIZE) && defined(__GNUC__) && !defined(__llvm__)
 		nestedLOCAL();
 		void __attribute__ ((noinline)) nestedLOCAL(void)
@@ -1493,7 +2470,7 @@ VAR xeq (void)
 
 /*********************************** PRIVATE ***********************************/
 
-			case TPRIVATE:
+			case TPRIVATE: LABEL(TPRIVATE)
 #if defined (REDUCE_STACK_SIZE) && defined(__GNUC__) && !defined(__llvm__)
 		nestedPRIVATE();
 		void __attribute__ ((noinline)) nestedPRIVATE(void)
@@ -1548,14 +2525,14 @@ VAR xeq (void)
 					esi = oldesi - 1 ;
 					for (seq=0; seq<1; seq++) ; // GCC bug?
 					// transfer secret [accs] to formal [esi] 
-					esi = argue ((signed char *)accs - 1, esp + 2, 1) ;
+					esi = argue ((signed char *)accs - 1, esp + 2, 1, NULL) ;
 				    }
 				}
 				break ;
 
 /*********************************** ENDPROC ***********************************/
 
-			case TENDPROC:
+			case TENDPROC: LABEL(TENDPROC)
 				while (*(int *)esp != PROCHK)
 				    {
 					int ebx = *(int *)esp ;
@@ -1591,9 +2568,19 @@ VAR xeq (void)
 
 /***********************************  ENDFN  ***********************************/
 
-			case '=':
+			case '=': LABEL(equals)
 				{
-				VAR v = expr () ;
+				VAR v ;
+#ifdef TAILCALL
+				if (nxt () == TFN) // may follow spaces or a continuation
+				    {
+					esi++ ;
+					if (tailcall (FNCHK))
+						break ; // continue with the FN called
+					esi-- ;
+				    }
+#endif
+				v = expr () ;
 				if (v.s.t == -1)
 					v.s.p = moves ((STR *)&v, 0) - (char *) zero ;
 				while (*(int *)esp != FNCHK)
@@ -1633,7 +2620,7 @@ VAR xeq (void)
 
 /*********************************** RESTORE ***********************************/
 
-			case TRESTOR:
+			case TRESTOR: LABEL(TRESTOR)
 #if defined (REDUCE_STACK_SIZE) && defined(__GNUC__) && !defined(__llvm__)
 		nestedRESTOR();
 		void __attribute__ ((noinline)) nestedRESTOR(void)
@@ -1699,7 +2686,7 @@ VAR xeq (void)
 					edi = memchr (esi, 0x0D, 255) + 1 ;
 					while (--n)
 						edi += (int)*(unsigned char *)edi ;
-					datptr = search (edi, TDATA) - (signed char *) zero ;
+					datptr = datsrch (edi) - (signed char *) zero ;
 				    }
 				else if (!termq ())
 				    {
@@ -1707,17 +2694,17 @@ VAR xeq (void)
 					signed char *edi = findl (n) ;
 					if (edi == NULL)
 						error (41, NULL) ; // 'No such line'
-					datptr = search (edi, TDATA) - (signed char *) zero ;
+					datptr = datsrch (edi) - (signed char *) zero ;
 				    }
 				else
-					datptr = search (vpage + (signed char *) zero, TDATA) -
+					datptr = datsrch (vpage + (signed char *) zero) -
 							(signed char *) zero ;
 			    }
 			break ;
 
 /************************************ CALL *************************************/
 
-			case TCALL:
+			case TCALL: LABEL(TCALL)
 				{
 				VAR v = expr () ;
 				if (v.s.t != -1)
@@ -1774,7 +2761,7 @@ VAR xeq (void)
 
 /*********************************** INSTALL ***********************************/
 
-			case TINSTALL:
+			case TINSTALL: LABEL(TINSTALL)
 #if defined (REDUCE_STACK_SIZE) && defined(__GNUC__) && !defined(__llvm__)
 		nestedINSTALL();
 		void __attribute__ ((noinline)) nestedINSTALL(void)
@@ -1829,12 +2816,18 @@ VAR xeq (void)
 					    {
 						defscan (libase + (signed char *) zero) ;
 						defscan (vpage + (signed char *) zero) ;
+						clrjmp () ; // searches that failed may now succeed
+						clridx () ;
 					    }
 					else
 					    {
 						ISTORE(newtop, 0xF8000005) ;
 						SSTORE(newtop + 4, 0x0D) ;
 						check () ;
+						clrsym () ; // may reuse a previous module's addresses
+						clrcon () ;
+						clrjmp () ;
+						clridx () ;
 						esp -= STRIDE ;
 						*(void **)esp = esi ;
 						*--esp = GOSCHK ;
@@ -1849,7 +2842,7 @@ VAR xeq (void)
 
 /************************************ TRACE ************************************/
 
-			case TTRACE:
+			case TTRACE: LABEL(TTRACE)
 				switch (*esi)
 				    {
 					case TON:
@@ -1878,7 +2871,7 @@ VAR xeq (void)
 
 /************************************ BPUT *************************************/
 
-			case TBPUT:
+			case TBPUT: LABEL(TBPUT)
 #if defined (REDUCE_STACK_SIZE) && defined(__GNUC__) && !defined(__llvm__)
 		nestedBPUT();
 		void __attribute__ ((noinline)) nestedBPUT(void)
@@ -1910,7 +2903,7 @@ VAR xeq (void)
 
 /************************************  PTR  ************************************/
 
-			case TPTRL:
+			case TPTRL: LABEL(TPTRL)
 #if defined (REDUCE_STACK_SIZE) && defined(__GNUC__) && !defined(__llvm__)
 		nestedPTR();
 		void __attribute__ ((noinline)) nestedPTR(void)
@@ -1951,7 +2944,7 @@ VAR xeq (void)
 
 /************************************  EXT  ************************************/
 
-			case TEXTR:
+			case TEXTR: LABEL(TEXTR)
 				{
 				long long n ;
 				void *chan = channel () ;
@@ -1962,7 +2955,7 @@ VAR xeq (void)
 
 /************************************ PAGE *************************************/
 
-			case TPAGEL:
+			case TPAGEL: LABEL(TPAGEL)
 				{
 				equals () ;
 				void *n = (void *) (size_t) expri () ;
@@ -1974,7 +2967,7 @@ VAR xeq (void)
 
 /************************************ LOMEM ************************************/
 
-			case TLOMEML:
+			case TLOMEML: LABEL(TLOMEML)
 				{
 				equals () ;
 				void *n = (void *) (size_t) expri () ;
@@ -1988,7 +2981,7 @@ VAR xeq (void)
 
 /************************************ HIMEM ************************************/
 
-			case THIMEML:
+			case THIMEML: LABEL(THIMEML)
 				{
 				equals () ;
 				void *n = (void *) (size_t) (expri () & -4) ; // align
@@ -2006,6 +2999,10 @@ VAR xeq (void)
 #endif
 					proptr[0] = 0 ;
 					fnptr[0] = 0 ;
+					clrsym () ;
+					clrcon () ;
+					clrjmp () ;
+					clridx () ;
 				    }
 				}
 				break ;
@@ -2013,10 +3010,10 @@ VAR xeq (void)
 /************************************  RUN  ************************************/
 /************************************ CHAIN ************************************/
 
-			case TRUN:
+			case TRUN: LABEL(TRUN)
 				if (!termq ())
 					al = TCHAIN ;
-			case TCHAIN:
+			case TCHAIN: LABEL(TCHAIN)
 				if (al == TCHAIN)
 				    {
 					VAR v = exprs () ;
@@ -2035,7 +3032,7 @@ VAR xeq (void)
 
 /************************************ READ *************************************/
 
-			case TREAD:
+			case TREAD: LABEL(TREAD)
 				if (*esi != '#')
 				    {
 #if defined (REDUCE_STACK_SIZE) && defined(__GNUC__) && !defined(__llvm__)
@@ -2051,6 +3048,66 @@ VAR xeq (void)
 					signed char *edx = datptr + (signed char *) zero ;
 					while (1)
 					    {
+#ifdef DATCACHE
+						DATENT *d = datget (datptr) ;
+						if (d)
+						    {
+							edx = d->at + 1 + (signed char *) zero ;
+							ptr = getput (&type) ;
+							if (type & BIT6)
+								error (14, NULL) ; // 'Bad use of array'
+							if (type & BIT4)
+								error (56, NULL) ; // 'Bad use of structure'
+							if ((type < 128) && d->nend)
+							    {
+								curlin = edx - (signed char *) zero ;
+								storen (d->v, ptr, type) ;
+								datnxt (d, d->nend) ;
+							    }
+							else if ((type >= 128) && d->send)
+							    {
+								VAR v ;
+								memcpy (accs, d->str + zero, d->len) ;
+								*(accs + d->len) = 0x0D ;
+								v.s.l = d->len ;
+								v.s.p = accs - (char *) zero ;
+								stores (v, ptr, type) ;
+								datnxt (d, d->send) ;
+							    }
+							else if (type < 128)
+							    {
+								VAR v ;
+								signed char *oldesi = esi ;
+								esi = edx ;
+								curlin = esi - (signed char *) zero ;
+								v = exprn () ;
+								edx = esi ;
+								esi = oldesi ;
+								if (d->lit)
+								    {
+									d->v = v ;
+									d->nend = edx - (signed char *) zero ;
+								    }
+								storen (v, ptr, type) ;
+								datnxt (d, edx - (signed char *) zero) ;
+							    }
+							else
+							    {
+								VAR v ;
+								v.s.l = fetchs ((char **) &edx) ;
+								v.s.p = accs - (char *) zero ;
+								stores (v, ptr, type) ;
+								datptr = edx - (signed char *) zero ;
+							    }
+							if (nxt () != ',')
+								break ;
+							esi++ ;
+							nxt () ;
+							curlin = esi - (signed char *) zero ;
+							edx = datptr + (signed char *) zero ;
+							continue ;
+						    }
+#endif
 						signed char al = *edx++ ;
 						if ((al != TDATA) && (al != ','))
 						    {
@@ -2106,7 +3163,7 @@ VAR xeq (void)
 
 /************************************ INPUT ************************************/
 
-			case TINPUT:
+			case TINPUT: LABEL(TINPUT)
 #if defined (REDUCE_STACK_SIZE) && defined(__GNUC__) && !defined(__llvm__)
 		nestedINPUT();
 		void __attribute__ ((noinline)) nestedINPUT(void)
@@ -2241,7 +3298,7 @@ VAR xeq (void)
 
 /************************************ PRINT ************************************/
 
-			case TPRINT:
+			case TPRINT: LABEL(TPRINT)
 #if defined (REDUCE_STACK_SIZE) && defined(__GNUC__) && !defined(__llvm__)
 		nestedPRINT();
 		void __attribute__ ((noinline)) nestedPRINT(void)
@@ -2332,19 +3389,19 @@ VAR xeq (void)
 
 /*********************************** WIDTH *************************************/
 
-			case TWIDTH:
+			case TWIDTH: LABEL(TWIDTH)
 				vwidth = expri () ;
 				break ;
 
 /*********************************** CLOSE *************************************/
 
-			case TCLOSE:
+			case TCLOSE: LABEL(TCLOSE)
 				osshut (channel ()) ;
 				break ;
 
 /***********************************  OFF  *************************************/
 
-			case TOFF:
+			case TOFF: LABEL(TOFF)
 				oswrch (23) ;
 				oswrch (1) ;
 				for (al = 0; al < 8; al++)
@@ -2353,7 +3410,7 @@ VAR xeq (void)
 
 /*********************************** ERROR *************************************/
 
-			case TERROR:
+			case TERROR: LABEL(TERROR)
 #if defined (REDUCE_STACK_SIZE) && defined(__GNUC__) && !defined(__llvm__)
 		nestedERROR();
 		void __attribute__ ((noinline)) nestedERROR(void)
@@ -2370,7 +3427,7 @@ VAR xeq (void)
 
 /*********************************** CLEAR *************************************/
 
-			case TCLEAR:
+			case TCLEAR: LABEL(TCLEAR)
 				clear () ;
 				datptr = search (vpage + (signed char *) zero, TDATA) -
 						(signed char *) zero ;
@@ -2378,7 +3435,7 @@ VAR xeq (void)
 
 /***********************************  VDU  *************************************/
 
-			case TVDU:
+			case TVDU: LABEL(TVDU)
 				do
 				    {
 					int n = expri () ;
@@ -2402,20 +3459,20 @@ VAR xeq (void)
 
 /***********************************  CLS  *************************************/
 
-			case TCLS:
+			case TCLS: LABEL(TCLS)
 				oswrch (12) ;
 				vcount = 0 ;
 				break ;
 
 /***********************************  CLG  *************************************/
 
-			case TCLG:
+			case TCLG: LABEL(TCLG)
 				oswrch (16) ;
 				break ;
 
 /***********************************  MODE  ************************************/
 
-			case TMODE:
+			case TMODE: LABEL(TMODE)
 				{
 				int n = expri () ;
 				oswrch (22) ;
@@ -2426,7 +3483,7 @@ VAR xeq (void)
 
 /*********************************** COLOUR ************************************/
 
-			case TCOLOUR:
+			case TCOLOUR: LABEL(TCOLOUR)
 #if defined (REDUCE_STACK_SIZE) && defined(__GNUC__) && !defined(__llvm__)
 		nestedCOLOUR();
 		void __attribute__ ((noinline)) nestedCOLOUR(void)
@@ -2463,7 +3520,7 @@ VAR xeq (void)
 
 /***********************************  GCOL  ************************************/
 
-			case TGCOL:
+			case TGCOL: LABEL(TGCOL)
 				{
 				int m = 0, n = expri () ;
 				if (*esi == ',')
@@ -2480,13 +3537,13 @@ VAR xeq (void)
 
 /**************************  TINT (not implemented)  ***************************/
 
-			case TTINT:
+			case TTINT: LABEL(TTINT)
 				expri () ;
 				break ;
 
 /***********************************  MOVE  ************************************/
 
-			case TMOVE:
+			case TMOVE: LABEL(TMOVE)
 				{
 				int c = 4, x, y ;
 				if (*esi == TBY)
@@ -2503,7 +3560,7 @@ VAR xeq (void)
 
 /***********************************  DRAW  ************************************/
 
-			case TDRAW:
+			case TDRAW: LABEL(TDRAW)
 				{
 				int c = 5, x, y ;
 				if (*esi == TBY)
@@ -2520,7 +3577,7 @@ VAR xeq (void)
 
 /***********************************  FILL  ************************************/
 
-			case TFILL:
+			case TFILL: LABEL(TFILL)
 				{
 				int c = 133, x, y ;
 				if (*esi == TBY)
@@ -2537,7 +3594,7 @@ VAR xeq (void)
 
 /***********************************  LINE  ************************************/
 
-			case TLINE:
+			case TLINE: LABEL(TLINE)
 #if defined (REDUCE_STACK_SIZE) && defined(__GNUC__) && !defined(__llvm__)
 		nestedLINE();
 		void __attribute__ ((noinline)) nestedLINE(void)
@@ -2558,7 +3615,7 @@ VAR xeq (void)
 
 /*********************************** ORIGIN ************************************/
 
-			case TORIGIN:
+			case TORIGIN: LABEL(TORIGIN)
 				{
 				int x, y ;
 				x = expri () ;
@@ -2574,7 +3631,7 @@ VAR xeq (void)
 
 /***********************************  PLOT  ************************************/
 
-			case TPLOT:
+			case TPLOT: LABEL(TPLOT)
 				{
 				int n, x, y ;
 				if (*esi == TBY)
@@ -2605,7 +3662,7 @@ VAR xeq (void)
 
 /************************************ CIRCLE ***********************************/
 
-			case TCIRCLE:
+			case TCIRCLE: LABEL(TCIRCLE)
 #if defined (REDUCE_STACK_SIZE) && defined(__GNUC__) && !defined(__llvm__)
 		nestedCIRCLE();
 		void __attribute__ ((noinline)) nestedCIRCLE(void)
@@ -2629,7 +3686,7 @@ VAR xeq (void)
 
 /*********************************** ELLIPSE ***********************************/
 
-			case TELLIPSE:
+			case TELLIPSE: LABEL(TELLIPSE)
 #if defined (REDUCE_STACK_SIZE) && defined(__GNUC__) && !defined(__llvm__)
 		nestedELLIPSE();
 		void __attribute__ ((noinline)) nestedELLIPSE(void)
@@ -2656,7 +3713,7 @@ VAR xeq (void)
 
 /********************************** RECTANGLE **********************************/
 
-			case TRECT:
+			case TRECT: LABEL(TRECT)
 #if defined (REDUCE_STACK_SIZE) && defined(__GNUC__) && !defined(__llvm__)
 		nestedRECT();
 		void __attribute__ ((noinline)) nestedRECT(void)
@@ -2716,7 +3773,7 @@ VAR xeq (void)
 
 /*************************************  IF  ************************************/
 
-			case TIF:
+			case TIF: LABEL(TIF)
 				{
 				long long n = expri () ;
 				if (n)
@@ -2759,7 +3816,7 @@ VAR xeq (void)
 
 /*************************************  ON  ************************************/
 
-			case TON:
+			case TON: LABEL(TON)
 #if defined (REDUCE_STACK_SIZE) && defined(__GNUC__) && !defined(__llvm__)
 		nestedON();
 		void __attribute__ ((noinline)) nestedON(void)
@@ -2904,7 +3961,7 @@ VAR xeq (void)
 
 /************************************  FOR  ************************************/
 
-			case TFOR:
+			case TFOR: LABEL(TFOR)
 #if defined (REDUCE_STACK_SIZE) && defined(__GNUC__) && !defined(__llvm__)
 		nestedFOR();
 		void __attribute__ ((noinline)) nestedFOR(void)
@@ -2912,7 +3969,8 @@ VAR xeq (void)
 				{
 				void *ptr ;
 				unsigned char type ;
-				VAR v ;
+				VAR v, L ;
+				int intloop = 0 ;
 
 				ptr = getvar (&type) ;
 				if (ptr == NULL)
@@ -2924,14 +3982,8 @@ VAR xeq (void)
 				assign (ptr, type) ;
 				if (*esi++ != TTO)
 					error (36, NULL) ; // 'Missing TO'
-				esp -= STRIDE ;
-				*(void **)esp = ptr ;
-				*--esp = (int) type ;
 
-				v = exprn () ; // limit
-				*--esp = (int)v.i.t ;
-				esp -= 2 ;
-				*(long long *) esp = v.i.n ;
+				L = exprn () ; // limit
 
 				if (*esi == TSTEP)
 				    {
@@ -2945,12 +3997,37 @@ VAR xeq (void)
 					v.i.t = 0 ;
 					v.i.n = 1 ;
 				    }
+
+#ifndef PICO
+				// An integer variable with an integer STEP only ever
+				// holds integers, so compares with a non-integer limit
+				// as it would with the limit rounded towards the start,
+				// and NEXT can then use native integer arithmetic:
+				if (((type == 4) || (type == 40)) && (v.i.t == 0))
+				    {
+					if ((L.i.t != 0) && (fabsl (L.f) < 0x1p53))
+					    {
+						L.i.n = (v.i.n >= 0) ? floorl (L.f) : ceill (L.f) ;
+						L.i.t = 0 ;
+					    }
+					intloop = (L.i.t == 0) ;
+				    }
+#endif
+
+				esp -= STRIDE ;
+				*(void **)esp = ptr ;
+				*--esp = (int) type ;
+
+				*--esp = (int)L.i.t ;
+				esp -= 2 ;
+				*(long long *) esp = L.i.n ;
+
 				*--esp = (int)v.i.t ;
 				esp -= 2 ;
 				*(long long *) esp = v.i.n ;
 
 				if (v.i.t == 0)
-					*--esp = (int) (v.i.n >= 0) ;
+					*--esp = (int) (v.i.n >= 0) | (intloop << 1) ;
 				else
 					*--esp = (int) (v.f >= 0.0) ;
 				esp -= STRIDE ;
@@ -2962,7 +4039,7 @@ VAR xeq (void)
 
 /************************************* NEXT *************************************/
 
-			case TNEXT:
+			case TNEXT: LABEL(TNEXT)
 #if defined (REDUCE_STACK_SIZE) && defined(__GNUC__) && !defined(__llvm__)
 		nestedNEXT();
 		void __attribute__ ((noinline)) nestedNEXT(void)
@@ -3025,6 +4102,33 @@ VAR xeq (void)
 					    }
 
 					type = (char) (int) *(esp + 8 + STRIDE) ;
+					al = *(signed char *)(esp + 1 + STRIDE) ;
+#ifndef PICO
+					if (al & 2) // integer variable, limit and STEP
+					    {
+						long long n, m ;
+						long long step = *(long long *)(esp + 2 + STRIDE) ;
+						long long lim = *(long long *)(esp + 5 + STRIDE) ;
+						if (type == 4)
+							n = (int) ILOAD(ptr) ;
+						else
+							memcpy (&n, ptr, 8) ; // may be unaligned
+						m = (long long)((unsigned long long) n + step) ;
+						if ((((m ^ n) >= 0) || ((n ^ step) < 0)) &&
+						    ((type == 40) || (m == (int) m)))
+						    {
+							if (type == 4)
+								ISTORE(ptr, (int) m) ;
+							else
+								memcpy (ptr, &m, 8) ; // may be unaligned
+							if (al & 1)
+								b = m > lim ;
+							else
+								b = m < lim ;
+							goto nextb ;
+						    }
+					    }
+#endif
 					v = loadn (ptr, type) ;
 					s.i.t = *(short *)(esp + 4 + STRIDE) ;
 					s.i.n = *(long long *)(esp + 2 + STRIDE) ;
@@ -3052,12 +4156,11 @@ VAR xeq (void)
 					    }
 					storen (v, ptr, type) ;
 
-					al = *(signed char *)(esp + 1 + STRIDE) ;
 					L.i.t = *(short *)(esp + 7 + STRIDE) ;
 					L.i.n = *(long long*)(esp + 5 + STRIDE) ;
 					if ((v.i.t == 0) && (L.i.t == 0))
 					    {
-						if (al)
+						if (al & 1)
 							b = v.i.n > L.i.n ;
 						else
 							b = v.i.n < L.i.n ;
@@ -3074,12 +4177,14 @@ VAR xeq (void)
 							L.i.t = 1 ; // ARM
 							L.f = L.i.n ;
 						    }
-						if (al)
+						if (al & 1)
 							b = v.f > L.f ;
 						else
 							b = v.f < L.f ;
 					    }
-
+#ifndef PICO
+					nextb:
+#endif
 					if (b)
 					    {
 						esp += 9 + 2 * STRIDE ;
@@ -3099,7 +4204,7 @@ VAR xeq (void)
 
 /*********************************** REPEAT ************************************/
 
-			case TREPEAT:
+			case TREPEAT: LABEL(TREPEAT)
 				check () ;
 				esp -= STRIDE ;
 				*(void **)esp = esi ;
@@ -3108,7 +4213,7 @@ VAR xeq (void)
 
 /*********************************** UNTIL *************************************/
 
-			case TUNTIL:
+			case TUNTIL: LABEL(TUNTIL)
 				while (*(int *)esp != REPCHK)
 				    {
 					if (*(int *)esp == ONCHK)
@@ -3137,7 +4242,7 @@ VAR xeq (void)
 
 /*********************************** WHILE *************************************/
 
-			case TWHILE:
+			case TWHILE: LABEL(TWHILE)
 				check () ;
 				esp -= STRIDE ;
 				*(void **)esp = esi ;
@@ -3151,7 +4256,7 @@ VAR xeq (void)
 
 /********************************* ENDWHILE ************************************/
 
-			case TENDWHILE:
+			case TENDWHILE: LABEL(TENDWHILE)
 				while (*(int *)esp != WHICHK)
 				    {
 					if (*(int *)esp == ONCHK)
@@ -3181,7 +4286,7 @@ VAR xeq (void)
 
 /************************************ EXIT *************************************/
 
-			case TEXIT:
+			case TEXIT: LABEL(TEXIT)
 #if defined (REDUCE_STACK_SIZE) && defined(__GNUC__) && !defined(__llvm__)
 		nestedEXIT();
 		void __attribute__ ((noinline)) nestedEXIT(void)
@@ -3267,7 +4372,7 @@ VAR xeq (void)
 
 /************************************ SWAP *************************************/
 
-			case TSWAP:
+			case TSWAP: LABEL(TSWAP)
 #if defined (REDUCE_STACK_SIZE) && defined(__GNUC__) && !defined(__llvm__)
 		nestedSWAP();
 		void __attribute__ ((noinline)) nestedSWAP(void)
@@ -3317,7 +4422,7 @@ VAR xeq (void)
 
 /************************************ CASE *************************************/
 
-			case TCASE:
+			case TCASE: LABEL(TCASE)
 #if defined (REDUCE_STACK_SIZE) && defined(__GNUC__) && !defined(__llvm__)
 		nestedCASE();
 		void __attribute__ ((noinline)) nestedCASE(void)
@@ -3333,6 +4438,19 @@ VAR xeq (void)
 					error (37, NULL) ; // 'Missing OF'
 				if (*esi++ != 0x0D)
 					error (48, NULL) ; // 'OF not last'
+#ifdef CASECACHE
+				    {
+					int found ;
+					signed char *to = caseget (v, &found) ;
+					if (to)
+					    {
+						esi = to ;
+						if (found)
+							goto xeq1 ; // Found
+						break ; // Not found
+					    }
+				    }
+#endif
 				if (v.s.t == -1)
 					oldesp = pushs (v) ;
 				while (1)
@@ -3392,7 +4510,7 @@ VAR xeq (void)
 
 /******************************* TIME and TIME$ ********************************/
 
-			case TTIMEL:
+			case TTIMEL: LABEL(TTIMEL)
 #ifdef CAN_SET_RTC
 				if ( *esi == '$' )
 				    {
@@ -3409,7 +4527,7 @@ VAR xeq (void)
 
 /************************************ WAIT *************************************/
 
-			case TWAIT:
+			case TWAIT: LABEL(TWAIT)
 				{
 				int n ;
 				if (termq ())
@@ -3422,14 +4540,14 @@ VAR xeq (void)
 
 /*********************************** REPORT ************************************/
 
-			case TREPORT:
+			case TREPORT: LABEL(TREPORT)
 				report () ;
 				text (accs) ;
 				break ;
 
 /*********************************** MOUSE *************************************/
 
-			case TMOUSE:
+			case TMOUSE: LABEL(TMOUSE)
 #if defined (REDUCE_STACK_SIZE) && defined(__GNUC__) && !defined(__llvm__)
 		nestedMOUSE();
 		void __attribute__ ((noinline)) nestedMOUSE(void)
@@ -3492,7 +4610,7 @@ VAR xeq (void)
 
 /***********************************  SYS  *************************************/
 
-			case TSYS:
+			case TSYS: LABEL(TSYS)
 #if defined (REDUCE_STACK_SIZE) && defined(__GNUC__) && !defined(__llvm__)
 		nestedSYS();
 		void __attribute__ ((noinline)) nestedSYS(void)
@@ -3619,14 +4737,14 @@ VAR xeq (void)
 
 /*********************************** OSCLI *************************************/
 
-			case TOSCLI:
+			case TOSCLI: LABEL(TOSCLI)
 				fixs (exprs ()) ;
 				oscli (accs) ;
 				break ;
 
 /*********************************** SOUND *************************************/
 
-			case TSOUND:
+			case TSOUND: LABEL(TSOUND)
 #if defined (REDUCE_STACK_SIZE) && defined(__GNUC__) && !defined(__llvm__)
 		nestedSOUND();
 		void __attribute__ ((noinline)) nestedSOUND(void)
@@ -3653,7 +4771,7 @@ VAR xeq (void)
 
 /********************************** ENVELOPE ***********************************/
 
-			case TENVEL:
+			case TENVEL: LABEL(TENVEL)
 #if defined (REDUCE_STACK_SIZE) && defined(__GNUC__) && !defined(__llvm__)
 		nestedENVEL();
 		void __attribute__ ((noinline)) nestedENVEL(void)
@@ -3673,7 +4791,7 @@ VAR xeq (void)
 
 /************************************* DIM *************************************/
 
-			case TDIM:
+			case TDIM: LABEL(TDIM)
 #if defined (REDUCE_STACK_SIZE) && defined(__GNUC__) && !defined(__llvm__)
 		nestedDIM();
 		void __attribute__ ((noinline)) nestedDIM(void)
@@ -3989,26 +5107,26 @@ VAR xeq (void)
 
 /*********************************** Label *************************************/
 
-			case '(':
+			case '(': LABEL(label)
 				while ((*esi != 0x0D) && (*esi++ != ')')) ;
 				break ;
 
 /******************************* Star command **********************************/
 
-			case '*':
+			case '*': LABEL(star)
 				oscli ((char *) esi) ;
 				esi = (signed char*) memchr ((char *) esi, 0x0D, 255) ;
 				break ;
 
 /********************************* Assembler ***********************************/
 
-			case '[':
+			case '[': LABEL(assembler)
 				assemble () ;
 				break ;
 
 /******************************** End of Line **********************************/
 
-			case 0x0D:
+			case 0x0D: LABEL(eol)
 				esi = tmpesi + 1 ;
 				newlin () ;
 				al = *esi ;
@@ -4040,9 +5158,9 @@ VAR xeq (void)
 /********************************** RIGHT$ *************************************/
 /*********************************** MID$  *************************************/
 
-			case TLEFT:
-			case TRIGHT:
-			case TMID:
+			case TLEFT: LABEL(TLEFT)
+			case TRIGHT: LABEL(TRIGHT)
+			case TMID: LABEL(TMID)
 #if defined (REDUCE_STACK_SIZE) && defined(__GNUC__) && !defined(__llvm__)
 		nestedSLICE();
 		void __attribute__ ((noinline)) nestedSLICE(void)
@@ -4109,9 +5227,9 @@ VAR xeq (void)
 
 /************************************* LET *************************************/
 
-			default:
+			default: LABEL(default)
 				esi = tmpesi ;
-			case TLET:
+			case TLET: LABEL(TLET)
 			    {
 				void *ptr ;
 				unsigned char type ;
@@ -4189,6 +5307,8 @@ VAR xeq (void)
 					type &= ~BIT6 ;
 					if (type < 128)
 					    {
+						if (arrvec (ptr, ebp, (VAR) {0}, ecx, type, op))
+							ecx = 0 ; // done
 						while (ecx--)
 						    {
 							modify (loadn((void *)ebp, type), ptr, type, op) ;
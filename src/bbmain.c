@@ -11,6 +11,7 @@
 \*****************************************************************/
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 #include <setjmp.h>
@@ -34,15 +35,19 @@ void oscli (char*) ;            // Command Line Interface
 // Routines in bbexec:
 VAR xeq (void) ;		// Execute program
 char *secret (char *, unsigned char) ;
+void clrjmp (void) ;		// Discard jump-target cache etc.
 
 // Routines in bbeval:
 long long itemi (void);		// Return an integer numeric item
 long long expri (void);		// Evaluate an integer numeric expression
 long long loadi (void *, unsigned char) ;
+void clrcon (void) ;		// Discard numeric-constant cache
 
 // Forward references:
 void *getvar (unsigned char *) ;
 void *putvar (void *, unsigned char *) ;
+void clrsym (void) ;
+int inprog (signed char *) ;
 
 // Global jump buffer:
 jmp_buf env ;
@@ -56,6 +61,74 @@ heapptr *esp ;			// Stack pointer
 void *libtop ;			// For stack overflow checking
 #endif
 
+// Line index, built on first use and discarded by clear():
+typedef struct tagLINIDX
+{
+	heapptr base ;		// Start of program or libraries (0 = not built)
+	heapptr top ;		// Address of terminating zero
+	int num ;		// Number of lines (excluding terminator)
+	int max ;		// Number of entries allocated
+	heapptr *addr ;		// Address of each line, plus terminator
+	heapptr *aux ;		// Highest line number so far, or library name
+} LINIDX ;
+
+static LINIDX prgidx, libidx ;
+
+// Hashed symbol table, in front of the variable, FN/PROC and structure
+// member linked lists.  Each slot maps a list and the name as it appears
+// in the program to the result of scanll(); the lists themselves remain
+// authoritative.  Undefine SYMHASH to disable.
+#ifndef PICO
+#define SYMHASH 4096		// Initial number of slots (power of 2)
+#endif
+#define SYMKEY 30		// Longest name (incl. suffix) held in the table
+
+#ifdef SYMHASH
+typedef struct tagSYMENT
+{
+	void *list ;		// Linked-list base (NULL = empty slot)
+	void *ptr ;		// Pointer returned by scanll()
+	unsigned char adv ;	// Amount by which scanll() advanced esi
+	unsigned char len ;	// Length of key
+	char key[SYMKEY] ;	// Name, type suffix and '(' if any
+} SYMENT ;
+
+static SYMENT *symtab ;		// Table of slots
+static int symmax ;		// Number of slots (power of 2)
+static int symnum ;		// Number of slots in use
+#endif
+
+// Inline cache of variable references, keyed by their address in the
+// program, so that executing the same reference again skips locate().
+// Entries stay valid until clear(): variables never move and LOCAL or
+// PRIVATE only save and restore their values.  Undefine VARCACHE to disable.
+#ifndef PICO
+#define VARCACHE 4096		// Number of entries (power of 2)
+#endif
+
+#ifdef VARCACHE
+typedef struct tagVARENT
+{
+	heapptr addr ;		// Address of reference in program (0 = unused)
+	unsigned char type ;	// Type returned by locate()
+	unsigned char adv ;	// Length of name in program
+	void *ptr ;		// Pointer returned by locate()
+} VARENT ;
+
+static VARENT *vartab ;		// Direct-mapped table
+#endif
+
+static heapptr prgtop ;		// Top of program when clear() last called
+
+// String allocation statistics for each size class (allocation 2^n-1 bytes):
+unsigned int strlive[32] ;	// Number of strings allocated
+unsigned int strused[32] ;	// Bytes used by those strings
+unsigned int strfree[32] ;	// Number of blocks in free lists
+
+int sortthreads ;		// Threads used by SORTUP/SORTDN (0 = one per CPU)
+int dotthreads ;		// Threads used by array dot products and reductions (0 = one per CPU)
+int noevalcache ;		// Non-zero to disable the EVAL cache
+
 // List of immediate mode commands:
 
 static const signed char comnds[] = {
@@ -650,6 +723,15 @@ void clear (void)
 	pfree = lomem + 4 * fastvars ;
 	memset (dynvar, 0, 4 * (54 + 2)) ;
 	memset (flist, 0, sizeof(void *) * 33 + 8) ;
+	memset (strlive, 0, sizeof(strlive)) ;
+	memset (strused, 0, sizeof(strused)) ;
+	memset (strfree, 0, sizeof(strfree)) ;
+	prgidx.base = 0 ; // Program may have been edited
+	libidx.base = 0 ;
+	prgtop = top - (signed char *) zero ;
+	clrsym () ;
+	clrjmp () ;
+	clrcon () ;
         // link00 is a non-aligned 32-bit word 
         for(i=0; i<4; i++)
             ((volatile char *)&link00)[i]=0;
@@ -672,15 +754,108 @@ static signed char* findlin (signed char *ebx, signed char *edx, char **pebp)
 	return (ebx - n) ;
 }
 
+// Build (if necessary) the line index for the program or libraries
+// starting at 'base'.  For the program the auxiliary entry holds the
+// highest line number up to and including that line, which is monotonic
+// even if the line numbers themselves are not; for the libraries it holds
+// the address of the library name in force.  Return NULL if no memory.
+static LINIDX *mkidx (LINIDX *idx, heapptr base, int lib)
+{
+	signed char *ebx = base + (signed char *) zero ;
+	heapptr aux = 0 ;
+	int i, n, num = 0 ;
+
+	if ((idx->base == base) && (*(idx->top + (signed char *) zero) == 0))
+		return idx ;
+
+	while ((n = (int)*(unsigned char *)ebx) != 0)
+	    {
+		ebx += n ;
+		num++ ;
+	    }
+
+	if (num >= idx->max)
+	    {
+		heapptr *addr = realloc (idx->addr, (num + 1) * sizeof(heapptr)) ;
+		heapptr *tmp ;
+		if (addr == NULL)
+			return NULL ;
+		idx->addr = addr ;
+		tmp = realloc (idx->aux, (num + 1) * sizeof(heapptr)) ;
+		if (tmp == NULL)
+			return NULL ;
+		idx->aux = tmp ;
+		idx->max = num + 1 ;
+	    }
+
+	ebx = base + (signed char *) zero ;
+	for (i = 0; i <= num; i++)
+	    {
+		if (lib)
+		    {
+			if ((i < num) && (*(ebx + 3) == 0))
+				aux = (ebx + 4) - (signed char *) zero ; // library name
+		    }
+		else if (SLOAD(ebx + 1) > aux)
+			aux = SLOAD(ebx + 1) ;
+		idx->addr[i] = ebx - (signed char *) zero ;
+		idx->aux[i] = aux ;
+		ebx += (int)*(unsigned char *)ebx ;
+	    }
+
+	idx->num = num ;
+	idx->top = idx->addr[num] ;
+	idx->base = base ;
+	return idx ;
+}
+
+// Discard the libraries' line index (a new library may end where
+// the one that was indexed did):
+void clridx (void)
+{
+	libidx.base = 0 ;
+}
+
+// Find the line containing a particular address using the index,
+// with the same results as findlin()
+static signed char* idxlin (LINIDX *idx, signed char *edx, char **pebp)
+{
+	heapptr addr = edx - (signed char *) zero ;
+	int lo = 0, hi = idx->num ;
+
+	if (pebp != NULL) *pebp = NULL ;
+	if ((edx < (signed char *) zero) || (addr < idx->addr[0]))
+		return NULL ;
+	if (addr >= idx->top)
+	    {
+		if ((pebp != NULL) && idx->aux[hi]) *pebp = idx->aux[hi] + zero ;
+		return NULL ;
+	    }
+	while (hi - lo > 1)
+	    {
+		int mid = (lo + hi) >> 1 ;
+		if (idx->addr[mid] <= addr)
+			lo = mid ;
+		else
+			hi = mid ;
+	    }
+	if ((pebp != NULL) && idx->aux[lo]) *pebp = idx->aux[lo] + zero ;
+	return idx->addr[lo] + (signed char *) zero ;
+}
+
 // Search user's program and libraries for
 // the line containing a particular address
 // If the address is not within the user's program
 // or libraries, return zero.
 unsigned short setlin (signed char *edx, char **pebp)
 {
-	signed char *tmp = findlin(vpage + zero, edx, NULL) ;
+	LINIDX *idx = mkidx (&prgidx, vpage, 0) ;
+	signed char *tmp = idx ? idxlin (idx, edx, NULL) : findlin (vpage + zero, edx, NULL) ;
 	if ((tmp == NULL) && (libase != 0))
-		tmp = findlin(libase + zero, edx, pebp) ;
+	    {
+		idx = mkidx (&libidx, libase, 1) ;
+		tmp = idx ? idxlin (idx, edx, pebp) : findlin (libase + zero, edx, pebp) ;
+	    }
 	if (tmp == NULL)
 		return 0 ;
 	return SLOAD(tmp + 1) ;
@@ -689,11 +864,13 @@ unsigned short setlin (signed char *edx, char **pebp)
 // Find a specified numbered line in the program by
 // searching from the beginning.  The performance of
 // GOTO, GOSUB and RESTORE is critically dependent
-// on the speed of this routine.
+// on the speed of this routine, so the line index is
+// binary-searched in preference to a linear scan.
 // Can optionally be entered with a target address.
 signed char * findl (unsigned int edx)
 {
 	signed char *ebx = vpage + (signed char *) zero ;
+	LINIDX *idx ;
 	if (*ebx == 0)
 		return NULL ; // No program
 	if ((edx + (signed char *) zero) >= ebx)
@@ -705,7 +882,21 @@ signed char * findl (unsigned int edx)
 		return NULL ;
 	    }
 	edx &= 0xFFFF ;
-	while (edx > SLOAD(ebx + 1))
+	idx = mkidx (&prgidx, vpage, 0) ;
+	if (idx != NULL)
+	    {
+		int lo = 0, hi = idx->num ;
+		while (lo < hi)
+		    {
+			int mid = (lo + hi) >> 1 ;
+			if (idx->aux[mid] >= edx)
+				hi = mid ;
+			else
+				lo = mid + 1 ;
+		    }
+		ebx = idx->addr[lo] + (signed char *) zero ;
+	    }
+	else while (edx > SLOAD(ebx + 1))
 		ebx += (int)*(unsigned char *)ebx ; 
 	if (edx == SLOAD(ebx + 1))
 		return ebx ;
@@ -742,19 +933,214 @@ unsigned short report (void)
 	return lino ;
 }
 
+// Update string statistics when a string changes from class old to class new:
+static void strstat (int old, unsigned int oldlen, int new, unsigned int len)
+{
+	strused[old] -= oldlen ;
+	strused[new] += len ;
+	if (old != new)
+	    {
+		if (old)
+			strlive[old]-- ;
+		if (new)
+			strlive[new]++ ;
+	    }
+}
+
+// Get a node for a free list, NULL if no room:
+static node *getnode (void)
+{
+	node *head = flist[0] ;
+	if (head) // spare node available?
+	    {
+		flist[0] = head->next ;
+		return head ;
+	    }
+	char *addr = ((pfree + 3) & -4) + (char *) zero ;
+	if ((addr + sizeof (node) + STACK_NEEDED) > (char *)esp)
+		return NULL ;
+	pfree = addr + sizeof (node) - (char *) zero ;
+	return (node *) addr ;
+}
+
+// Take the smallest free block larger than class n and split it in halves
+// until one is of class n, adding the others to the free lists (a block of
+// 2^k-1 bytes holds two of 2^(k-1)-1 bytes plus an alignment byte):
+static char *split (int n)
+{
+	int k ;
+	char *addr ;
+	node *head ;
+
+	for (k = n + 1; k < 32; k++)
+		if (flist[k])
+			break ;
+	if (k >= 32)
+		return NULL ;
+	head = flist[k] ;
+	flist[k] = head->next ;
+	strfree[k]-- ;
+	addr = head->data ;
+	head->next = flist[0] ; // now a spare node
+	flist[0] = head ;
+
+	while (k-- > n)
+	    {
+		head = getnode () ;
+		if (head == NULL)
+			break ; // use the remainder of the block as is
+		head->data = addr + (1 << k) ;
+		head->next = flist[k] ;
+		flist[k] = head ;
+		strfree[k]++ ;
+	    }
+	return addr ;
+}
+
+typedef struct tagSPAN
+{
+	char *p ;		// Start of free memory
+	char *e ;		// End of free memory
+} SPAN ;
+
+static int spancmp (const void *a, const void *b)
+{
+	char *p = ((const SPAN *) a)->p, *q = ((const SPAN *) b)->p ;
+	return (p > q) - (p < q) ;
+}
+
+// Divide free memory from p to e into the largest blocks that fit, listing
+// them with nodes taken from the pool (or from the heap once it is empty),
+// or if pool is NULL just count them:
+static int carve (char *p, char *e, node **pool, node *end)
+{
+	int k, n = 0 ;
+	while (1)
+	    {
+		node *head = NULL ;
+		p = (char *) (((size_t) p + 1) & -2) ; // Unicode align
+		if (p >= e)
+			break ;
+		k = 31 - __builtin_clz (e - p + 1) ;
+		if (k > 24)
+			k = 24 ; // largest needed for a string
+		if (pool)
+		    {
+			if (*pool < end)
+				head = (*pool)++ ;
+			else if ((head = getnode ()) == NULL)
+				break ;
+			head->data = p ;
+			head->next = flist[k] ;
+			flist[k] = head ;
+			strfree[k]++ ;
+		    }
+		n++ ;
+		p += (1 << k) - 1 ;
+	    }
+	return n ;
+}
+
+// Coalesce the free blocks, and the nodes which list them, into spans of
+// adjacent free memory (separated by no more than an alignment byte), give
+// back to the heap a span which reaches pfree, and divide the others into
+// the largest blocks that fit, the nodes to list them being taken from the
+// start of the largest span.  Live strings are not moved.  Return zero if
+// nothing was free:
+static int merge (void)
+{
+	SPAN *span ;
+	node *head, *pool, *end ;
+	int i, k, big, n = 0, m = 0 ;
+
+	for (k = 0; k < 32; k++)
+		for (head = flist[k]; head; head = head->next)
+			n += (k != 0) + 1 ;
+	if (n == 0)
+		return 0 ;
+	span = malloc (n * sizeof(SPAN)) ;
+	if (span == NULL)
+		return 0 ;
+
+	for (k = 0; k < 32; k++)
+	    {
+		for (head = flist[k]; head; head = head->next)
+		    {
+			if (k)
+			    {
+				span[m].p = head->data ;
+				span[m++].e = head->data + (1 << k) - 1 ;
+			    }
+			span[m].p = (char *) head ;
+			span[m++].e = (char *) head + sizeof (node) ;
+		    }
+		flist[k] = NULL ;
+		strfree[k] = 0 ;
+	    }
+
+	qsort (span, m, sizeof(SPAN), spancmp) ;
+	for (i = 1, n = 0; i < m; i++)
+	    {
+		if (span[i].p <= span[n].e + 1)
+		    {
+			if (span[i].e > span[n].e)
+				span[n].e = span[i].e ;
+		    }
+		else
+			span[++n] = span[i] ;
+	    }
+	n++ ;
+
+	if (span[n - 1].e >= pfree + (char *) zero)
+		pfree = span[--n].p - (char *) zero ;
+
+	for (i = 0, big = 0, m = 0; i < n; i++)
+		if ((span[i].e - span[i].p) > (span[big].e - span[big].p))
+			big = i ;
+	for (i = 0; i < n; i++)
+		if (i != big)
+			m += carve (span[i].p, span[i].e, NULL, NULL) ;
+
+	if (n)
+	    {
+		char *p = span[big].p, *e = span[big].e ;
+		pool = (node *) (((size_t) p + 3) & -4) ;
+		end = pool + m ;
+		while (((char *) end < e) && ((k = m + carve ((char *) end, e, NULL, NULL)) > (end - pool)))
+			end = pool + k ;
+		if ((char *) end > e)
+			end = pool + (e - (char *) pool) / (int) sizeof (node) ;
+		if (end < pool)
+			end = pool ;
+		span[big].p = (char *) end ;
+		for (i = 0; i < n; i++)
+			carve (span[i].p, span[i].e, &pool, end) ;
+		while (pool < end)
+		    {
+			pool->next = flist[0] ; // spare node
+			flist[0] = pool++ ;
+		    }
+	    }
+	free (span) ;
+	return 1 ;
+}
+
 // Free old string (if any) pointed to by descriptor,
 // allocate space for new string and update descriptor:
 char * allocs (unsigned int *ps, int len)
 {
 	char *addr ;
 	node *head ;
-	int new = 0, old = 0, size ;
+	int new = 0, old = 0, size, top, merged = 0 ;
+	unsigned int oldlen = ULOAD(ps+1) ;
+	heapptr oldfree = pfree ;
 
 	if (len)
 		new = 32 - __builtin_clz (len) ;
-	if (ULOAD(ps+1))
-		old = 32 - __builtin_clz (ULOAD(ps+1)) ;
+	if (oldlen)
+		old = 32 - __builtin_clz (oldlen) ;
 	USTORE(ps+1, len) ;
+	strstat (old, oldlen, new, len) ;
 
 // if old and new strings have the same allocation, just change the length:
 
@@ -764,17 +1150,28 @@ char * allocs (unsigned int *ps, int len)
 	    }
 
 	size = ((1 << new) - 1) ; // new allocation
+	top = old && ((ULOAD(ps) + (1 << old) - 1) == pfree) ; // old is at top of heap
 
 // the allocations differ: so first see if new allocation is in free list;
-// if it is, just swap with old allocation:
+// if it is, just swap with old allocation (or shrink the heap if the old
+// allocation is at the top):
 
 	if (flist[new] != NULL)
 	    {
 		head = flist[new] ;
 		flist[new] = head->next ; // remove from 'new' list
+		if (new)
+			strfree[new]-- ; // list 0 holds spare nodes, not blocks
+		addr = head->data ;
+		if (top)
+		    {
+			pfree = ULOAD(ps) ;
+			old = 0 ; // node becomes a spare
+		    }
+		else if (old)
+			strfree[old]++ ;
 		head->next = flist[old] ;
 		flist[old] = head ; 	  // insert into 'old' list
-		addr = head->data ;
 		head->data = ULOAD(ps) + (char *) zero ; 
 		USTORE(ps, addr - (char *) zero) ;
 		return addr ;
@@ -784,41 +1181,66 @@ char * allocs (unsigned int *ps, int len)
 // It is extremely important that a block in the free list is used *
 // IN PREFERENCE TO expanding into the heap.
 
-	if (old && ((ULOAD(ps) + (1 << old) - 1) == pfree))
+	if (top)
 	    {
 		addr = ULOAD(ps) + (char *) zero ;
-		if (size > ((char *)esp - addr - STACK_NEEDED))
-			error (0, NULL) ; // 'No room'
-		pfree = addr + size - (char *) zero ;
-		return addr ;
+		if (size <= ((char *)esp - addr - STACK_NEEDED))
+		    {
+			pfree = addr + size - (char *) zero ;
+			return addr ;
+		    }
 	    }
 
-// add old allocation to the free list (unless zero):
+// if there won't be room for it in the heap, split a larger free block,
+// coalescing the free blocks first if there is none:
 
-	if (old)
+	while (1)
 	    {
-		if (flist[0]) // spare node available?
+		heapptr base = pfree ;
+		if (top && (pfree != oldfree))
+			top = 0 ; // free-list nodes have been put above it
+		if (top)
+			base = ULOAD(ps) ;
+		else if (old && (flist[0] == NULL))
+			base = ((pfree + 3) & -4) + sizeof (node) ; // room for free-list node
+		addr = ((base + 1) & -2) + (char *) zero ; // Unicode align
+		if (size <= ((char *)esp - addr - STACK_NEEDED))
 		    {
-			head = flist[0] ; 
-			flist[0] = head->next ;
+			addr = NULL ;
+			break ;
 		    }
-		else
+		if ((addr = split (new)) != NULL)
+			break ;
+		if (merged++ || !merge ())
 		    {
-			addr = ((pfree + 3) & -4) + (char *) zero ;
-			pfree = addr + sizeof (node) - (char *) zero ;
-			head = (node *) addr ;
+			USTORE(ps+1, oldlen) ;
+			strstat (new, len, old, oldlen) ;
+			error (0, NULL) ; // 'No room'
 		    }
+	    }
+	if (top && (pfree != oldfree))
+		top = 0 ;
+
+// free the old allocation: shrink the heap if it is (still) at the top,
+// otherwise add it to the free list (unless zero):
+
+	if (top)
+		pfree = ULOAD(ps) ;
+	else if (old && ((head = getnode ()) != NULL))
+	    {
 		head->data = ULOAD(ps) + (char *) zero ;
 		head->next = flist[old] ;
 		flist[old] = head ;
+		strfree[old]++ ;
 	    }
 
 // allocate new string space from the heap:
 
-	addr = ((pfree + 1) & -2) + (char *) zero ; // Unicode align
-	if (size > ((char *)esp - addr - STACK_NEEDED))
-		error (0, NULL) ; // 'No room'
-	pfree = addr + size - (char *) zero ;
+	if (addr == NULL)
+	    {
+		addr = ((pfree + 1) & -2) + (char *) zero ; // Unicode align
+		pfree = addr + size - (char *) zero ;
+	    }
 	USTORE(ps, addr - (char *) zero) ;
 	return addr ;
 }
@@ -1090,6 +1512,152 @@ void * putdef (void *ebx)
 	return ebx ;
 }
 
+// Interpreter statistics, read by programs as e.g. !SYS("@jmphit"), and
+// settings, written as e.g. !SYS("@sortthreads") = 4.
+// The '@' prefix ensures they cannot clash with the names of API functions.
+// The string statistics are arrays indexed by size class, e.g. the number
+// of free blocks of 2^n-1 bytes is SYS("@strfree")!(n*4):
+extern unsigned int jmphit, jmpmiss, evalhit, evalmiss ;
+
+static const struct { const char *name ; void *addr ; } intvar[] = {
+	{"@jmphit", &jmphit},		// Jump-target cache hits
+	{"@jmpmiss", &jmpmiss},		// Jump-target cache misses
+	{"@evalhit", &evalhit},		// EVAL cache hits
+	{"@evalmiss", &evalmiss},	// EVAL cache misses
+	{"@strlive", strlive},		// Strings allocated
+	{"@strused", strused},		// Bytes used by allocated strings
+	{"@strfree", strfree},		// Blocks in string free lists
+	{"@sortthreads", &sortthreads},	// Sort threads (0 = automatic, 1 = none)
+	{"@dotthreads", &dotthreads},	// Matrix product and SUM/MOD threads (0 = automatic, 1 = none)
+	{"@noevalcache", &noevalcache},	// Non-zero to disable the EVAL cache
+	{NULL, NULL} } ;
+
+// Get the address of an interpreter statistic, or NULL if unknown:
+void *intadr (char *name)
+{
+	int i ;
+	if (*name != '@')
+		return NULL ;
+	for (i = 0; intvar[i].name; i++)
+		if (strcmp (name, intvar[i].name) == 0)
+			return intvar[i].addr ;
+	return NULL ;
+}
+
+// Test whether an address is within the program or libraries, rather than
+// the immediate-mode or EVAL buffer or code poked into the heap, and so is
+// a suitable key for the caches (which are discarded by clear, and when a
+// CALLed module is loaded or removed or the libraries are discarded):
+int inprog (signed char *p)
+{
+	heapptr addr = p - (signed char *) zero ;
+	return ((addr >= vpage) && (addr < prgtop)) || (libase && (addr >= libase)) ;
+}
+
+// Discard the hashed symbol table, e.g. because the lists have been emptied:
+void clrsym (void)
+{
+#ifdef SYMHASH
+	if (symnum)
+		memset (symtab, 0, symmax * sizeof(SYMENT)) ;
+	symnum = 0 ;
+#endif
+#ifdef VARCACHE
+	if (vartab)
+		memset (vartab, 0, VARCACHE * sizeof(VARENT)) ;
+#endif
+}
+
+#ifdef SYMHASH
+// Extract the name at esi as create() would parse it. Return its
+// length, or -1 if it is too long or the following character would
+// make scanll's result depend on more than the name itself:
+static int symkey (char *key)
+{
+	signed char *p = esi ;
+	int n = 0 ;
+
+	while (range1 (*p))
+	    {
+		if (n >= SYMKEY - 3)
+			return -1 ;
+		key[n++] = *p++ ;
+	    }
+	switch (*p)
+	    {
+		case '%':
+			key[n++] = *p++ ;
+			if (*p == '%')
+				key[n++] = *p++ ;
+			break ;
+		case '$':
+		case '#':
+		case '&':
+		case '{':
+		case '.':
+			key[n++] = *p++ ;
+	    }
+	if (*p == '(')
+		key[n++] = *p++ ;
+	if (*p == '%')
+		return -1 ;
+	return n ;
+}
+
+static unsigned int symhash (void *list, char *key, int len)
+{
+	unsigned int h = 2166136261u ^ (unsigned int)(size_t) list ;
+	while (len--)
+		h = (h ^ *(unsigned char *)key++) * 16777619u ;
+	return h ^ (h >> 15) ;
+}
+
+// Find slot for key, either the matching one or the empty one to fill:
+static SYMENT *symfind (void *list, char *key, int len)
+{
+	unsigned int i = symhash (list, key, len) ;
+	SYMENT *slot ;
+	while (1)
+	    {
+		slot = symtab + (i & (symmax - 1)) ;
+		if ((slot->list == NULL) || ((slot->list == list) && (slot->len == len) &&
+				(memcmp (slot->key, key, len) == 0)))
+			return slot ;
+		i++ ;
+	    }
+}
+
+// Add a result from scanll() to the table, growing it if necessary:
+static void symadd (void *list, char *key, int len, void *ptr, int adv)
+{
+	SYMENT *slot ;
+	if (2 * (symnum + 1) > symmax)
+	    {
+		SYMENT *old = symtab ;
+		int i, oldmax = symmax ;
+		int newmax = symmax ? symmax * 2 : SYMHASH ;
+		SYMENT *tmp = malloc (newmax * sizeof(SYMENT)) ;
+		if (tmp == NULL)
+			return ;
+		memset (tmp, 0, newmax * sizeof(SYMENT)) ;
+		symtab = tmp ;
+		symmax = newmax ;
+		for (i = 0; i < oldmax; i++)
+			if (old[i].list)
+				*symfind (old[i].list, old[i].key, old[i].len) = old[i] ;
+		free (old) ;
+	    }
+	slot = symfind (list, key, len) ;
+	if (slot->list == NULL)
+		symnum++ ;
+	slot->list = list ;
+	slot->ptr = ptr ;
+	slot->adv = adv ;
+	slot->len = len ;
+	memcpy (slot->key, key, len) ;
+}
+#endif
+
 // Scan linked-list for variable etc. (used for regular dynamic variables,
 // system variables, structure members, function and procedure definitions).
 // If found move to head of list unless sysvar or structure (base link = 0).
@@ -1100,10 +1668,34 @@ static void *scanll (heapptr *base, signed char *edi)
 	signed char *save = esi ;
 	void *prev = NULL, *this ;
 	int next ; // n.b. signed for relative links
+#ifdef SYMHASH
+	char key[SYMKEY] ;
+	void *list = base ;
+	int len = -1 ;
+#endif
 
 	if (base && (edi < ((signed char *) zero + 6)))
 		return NULL ; // not found
 
+#ifdef SYMHASH
+	// Structure templates on the stack may be overwritten, so only those
+	// in the heap are cacheable (as are the @ variables):
+	if ((base == NULL) && ((edi == (signed char *) &sysvar) ||
+	    ((edi >= lomem + (signed char *) zero) && (edi < pfree + (signed char *) zero))))
+		list = edi ;
+	if (list)
+		len = symkey (key) ;
+	if ((len >= 0) && symnum)
+	    {
+		SYMENT *slot = symfind (list, key, len) ;
+		if (slot->list)
+		    {
+			esi += slot->adv ;
+			return slot->ptr ;
+		    }
+	    }
+#endif
+
 	do
 	    {
 		this = edi ;
@@ -1128,6 +1720,10 @@ static void *scanll (heapptr *base, signed char *edi)
 			    }
 			if (*(esi-1) == '(')
 				esi-- ;
+#ifdef SYMHASH
+			if (len >= 0)
+				symadd (list, key, len, edi + 1, esi - save) ;
+#endif
 			return edi + 1 ;
 		    }
 		esi = save ;
@@ -1267,6 +1863,27 @@ static void *locate (unsigned char *ptype)
 			return NULL ;
 		al -= 4 ;
 	    }
+
+#ifdef VARCACHE
+	heapptr addr = esi - (signed char *) zero ;
+	VARENT *ent = NULL ;
+	if (inprog (esi))
+	    {
+		if (vartab == NULL)
+			vartab = calloc (VARCACHE, sizeof(VARENT)) ;
+		if (vartab != NULL)
+		    {
+			ent = vartab + (addr & (VARCACHE - 1)) ;
+			if (ent->addr == addr)
+			    {
+				esi += ent->adv ;
+				*ptype = ent->type ;
+				return ent->ptr ;
+			    }
+		    }
+	    }
+#endif
+
 	if (al == '@')
 	    {
 		ebx = NULL ;
@@ -1283,6 +1900,15 @@ static void *locate (unsigned char *ptype)
 		return ebx ;
 
 	*ptype = getype (ptr) ;
+#ifdef VARCACHE
+	if ((ent != NULL) && ((esi - (addr + (signed char *) zero)) < 256))
+	    {
+		ent->addr = addr ;
+		ent->type = *ptype ;
+		ent->adv = esi - (addr + (signed char *) zero) ;
+		ent->ptr = ptr ;
+	    }
+#endif
 	return ptr ;
 }
 